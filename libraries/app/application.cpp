@@ -42,12 +42,14 @@
 #include <fc/io/fstream.hpp>
 #include <fc/rpc/api_connection.hpp>
 #include <fc/rpc/websocket_api.hpp>
+#include <fc/thread/thread.hpp>
 #include <fc/network/resolve.hpp>
 
 #include <boost/filesystem/path.hpp>
 #include <boost/signals2.hpp>
 #include <boost/range/algorithm/reverse.hpp>
 
+#include <algorithm>
 #include <iostream>
 
 #include <fc/log/file_appender.hpp>
@@ -182,7 +184,7 @@ namespace detail {
          _websocket_server->on_connection([&]( const fc::http::websocket_connection_ptr& c ){
             auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c);
             auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
-            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()) );
+            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()), _self->get_api_thread() );
             wsc->register_api(fc::api<graphene::app::database_api>(db_api));
             wsc->register_api(fc::api<graphene::app::login_api>(login));
             c->set_session_data( wsc );
@@ -209,7 +211,7 @@ namespace detail {
          _websocket_tls_server->on_connection([&]( const fc::http::websocket_connection_ptr& c ){
             auto wsc = std::make_shared<fc::rpc::websocket_api_connection>(*c);
             auto login = std::make_shared<graphene::app::login_api>( std::ref(*_self) );
-            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()) );
+            auto db_api = std::make_shared<graphene::app::database_api>( std::ref(*_self->chain_database()), _self->get_api_thread() );
             wsc->register_api(fc::api<graphene::app::database_api>(db_api));
             wsc->register_api(fc::api<graphene::app::login_api>(login));
             c->set_session_data( wsc );
@@ -303,9 +305,84 @@ namespace detail {
                loaded_checkpoints[item.first] = item.second;
             }
          }
-         _chain_db->add_checkpoints( loaded_checkpoints );
 
-         if( _options->count("replay-blockchain") )
+         const uint32_t state_checkpoint_interval = _options->count("state-checkpoint-interval") ?
+                  _options->at("state-checkpoint-interval").as<uint32_t>() : 0;
+         const uint32_t state_checkpoints_per_merge = _options->count("state-checkpoints-per-merge") ?
+                  _options->at("state-checkpoints-per-merge").as<uint32_t>() : 0;
+
+         const uint32_t block_log_sync_blocks = _options->count("block-log-sync-blocks") ?
+                  _options->at("block-log-sync-blocks").as<uint32_t>() : 0;
+         const uint32_t block_log_sync_interval = _options->count("block-log-sync-interval") ?
+                  _options->at("block-log-sync-interval").as<uint32_t>() : 0;
+
+         const uint32_t index_statistics_interval = _options->count("index-statistics-interval") ?
+                  _options->at("index-statistics-interval").as<uint32_t>() : 0;
+
+         const bool state_digest = _options->count("state-digest") && _options->at("state-digest").as<bool>();
+
+         const uint64_t block_cache_size = _options->count("block-cache-size") ?
+                  _options->at("block-cache-size").as<uint64_t>() : 0;
+         const bool block_cache_packed = _options->count("block-cache-packed") && _options->at("block-cache-packed").as<bool>();
+
+         const bool transaction_id_index = _options->count("transaction-id-index") &&
+                  _options->at("transaction-id-index").as<bool>();
+
+         const uint32_t signature_recovery_threads = _options->count("signature-recovery-threads") ?
+                  _options->at("signature-recovery-threads").as<uint32_t>() : 0;
+
+         const uint32_t signature_cache_size = _options->count("signature-cache-size") ?
+                  _options->at("signature-cache-size").as<uint32_t>() : 0;
+
+         const uint64_t pending_transactions_size = _options->count("pending-transactions-size") ?
+                  _options->at("pending-transactions-size").as<uint64_t>() : 0;
+         const uint32_t pending_transactions_per_account = _options->count("pending-transactions-per-account") ?
+                  _options->at("pending-transactions-per-account").as<uint32_t>() : 0;
+
+         const uint32_t api_threads = _options->count("api-threads") ? _options->at("api-threads").as<uint32_t>() : 0;
+         for( uint32_t i = 0; i < api_threads; ++i )
+            _api_threads.push_back( std::make_shared<fc::thread>( "api_" + fc::to_string( uint64_t(i) ) ) );
+
+         // applied again to the database that replaces one that could not be opened
+         auto configure_chain_db = [&]()
+         {
+            _chain_db->add_checkpoints( loaded_checkpoints );
+            _chain_db->set_state_checkpoint_interval( state_checkpoint_interval, state_checkpoints_per_merge );
+            _chain_db->set_block_log_sync_policy( block_log_sync_blocks, block_log_sync_interval );
+            _chain_db->set_index_statistics_interval( index_statistics_interval );
+            _chain_db->enable_state_digest( state_digest );
+            _chain_db->set_block_cache_size( block_cache_size * 1024 * 1024, block_cache_packed );
+            _chain_db->enable_transaction_id_index( transaction_id_index );
+            _chain_db->set_signature_recovery_threads( signature_recovery_threads );
+            _chain_db->set_signature_cache_size( signature_cache_size );
+            _chain_db->set_pending_transaction_limits( pending_transactions_size * 1024 * 1024,
+                                                       pending_transactions_per_account );
+            _chain_db->enable_read_views( api_threads > 0 );
+         };
+         configure_chain_db();
+
+         auto write_db_version = [&]()
+         {
+            if( !fc::exists( _data_dir / "db_version" ) )
+            {
+               std::ofstream db_version(
+                  (_data_dir / "db_version").generic_string().c_str(),
+                  std::ios::out | std::ios::binary | std::ios::trunc );
+               std::string version_string = GRAPHENE_CURRENT_DB_VERSION;
+               db_version.write( version_string.c_str(), version_string.size() );
+               db_version.close();
+            }
+         };
+
+         if( _options->count("import-snapshot") )
+         {
+            const fc::path snapshot = _options->at("import-snapshot").as<boost::filesystem::path>();
+            ilog("Starting from the snapshot in ${s} on user request.", ("s", snapshot));
+            fc::create_directories( _data_dir );
+            _chain_db->open_from_snapshot(_data_dir / "blockchain", snapshot);
+            // the blocks before the snapshot are not in the block log, a replay starts from the copy of it kept
+            write_db_version();
+         } else if( _options->count("replay-blockchain") )
          {
             ilog("Replaying blockchain on user request.");
             _chain_db->reindex(_data_dir/"blockchain", initial_state());
@@ -337,21 +414,34 @@ namespace detail {
 
                // doing this down here helps ensure that DB will be wiped
                // if any of the above steps were interrupted on a previous run
-               if( !fc::exists( _data_dir / "db_version" ) )
-               {
-                  std::ofstream db_version(
-                     (_data_dir / "db_version").generic_string().c_str(),
-                     std::ios::out | std::ios::binary | std::ios::trunc );
-                  std::string version_string = GRAPHENE_CURRENT_DB_VERSION;
-                  db_version.write( version_string.c_str(), version_string.size() );
-                  db_version.close();
-               }
+               write_db_version();
             } else {
               _chain_db->open(_data_dir / "blockchain", initial_state);
             }
          } else {
-            wlog("Detected unclean shutdown. Replaying blockchain...");
-            _chain_db->reindex(_data_dir / "blockchain", initial_state());
+            bool recovered = false;
+            if( state_checkpoint_interval > 0 )
+            {
+               wlog("Detected unclean shutdown. Restoring from the last state checkpoint...");
+               try
+               {
+                  _chain_db->open(_data_dir / "blockchain", initial_state);
+                  recovered = true;
+               }
+               catch( const fc::exception& e )
+               {
+                  wlog( "Unable to restore from the last state checkpoint: ${e}", ("e",e.to_detail_string()) );
+                  // the objects loaded before the failure would keep reindex() from starting at genesis
+                  _chain_db.reset();
+                  _chain_db = std::make_shared<chain::database>();
+                  configure_chain_db();
+               }
+            }
+            if( !recovered )
+            {
+               wlog("Detected unclean shutdown. Replaying blockchain...");
+               _chain_db->reindex(_data_dir / "blockchain", initial_state());
+            }
          }
 
          if (!_options->count("genesis-json") &&
@@ -360,10 +450,21 @@ namespace detail {
             _chain_db->wipe(_data_dir / "blockchain", true);
             _chain_db.reset();
             _chain_db = std::make_shared<chain::database>();
-            _chain_db->add_checkpoints(loaded_checkpoints);
+            configure_chain_db();
             _chain_db->open(_data_dir / "blockchain", initial_state);
          }
 
+         if( _options->count("create-snapshot") )
+         {
+            const fc::path snapshot = _options->at("create-snapshot").as<boost::filesystem::path>();
+            _chain_db->create_snapshot( snapshot );
+            std::cerr << "Saved a snapshot of block " << _chain_db->head_block_num() << " to " << snapshot.generic_string() << "\n";
+            _chain_db->close();
+            // std::exit() skips ~application_impl, and a marker left behind would make the next start replay
+            fc::remove_all( _data_dir / "blockchain/dblock" );
+            std::exit(EXIT_SUCCESS);
+         }
+
          if( _options->count("force-validate") )
          {
             ilog( "All transaction signatures will be validated" );
@@ -458,7 +559,8 @@ namespace detail {
             // you can help the network code out by throwing a block_older_than_undo_history exception.
             // when the net code sees that, it will stop trying to push blocks from that chain, but
             // leave that peer connected so that they can get sync blocks from us
-            bool result = _chain_db->push_block(blk_msg.block, (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures);
+            bool result = _chain_db->push_block(std::make_shared<const graphene::chain::shared_block>(blk_msg.block),
+                                                (_is_block_producer | _force_validate) ? database::skip_nothing : database::skip_transaction_signatures);
 
             // the block was accepted, so we now know all of the transactions contained in the block
             if (!sync_mode)
@@ -564,11 +666,10 @@ namespace detail {
            if (!found_a_block_in_synopsis)
              FC_THROW_EXCEPTION(graphene::net::peer_is_on_an_unreachable_fork, "Unable to provide a list of blocks starting at any of the blocks in peer's synopsis");
          }
-         for( uint32_t num = block_header::num_from_id(last_known_block_id);
-              num <= _chain_db->head_block_num() && result.size() < limit;
-              ++num )
-            if( num > 0 )
-               result.push_back(_chain_db->get_block_id_for_num(num));
+         const uint32_t first = std::max<uint32_t>( block_header::num_from_id(last_known_block_id), 1 );
+         if( limit > 0 && first <= _chain_db->head_block_num() )
+            result = _chain_db->get_block_ids_for_nums( first,
+                        uint32_t( std::min<uint64_t>( _chain_db->head_block_num(), uint64_t(first) + limit - 1 ) ) );
 
          if( !result.empty() && block_header::num_from_id(result.back()) < _chain_db->head_block_num() )
             remaining_item_count = _chain_db->head_block_num() - block_header::num_from_id(result.back());
@@ -584,13 +685,20 @@ namespace detail {
         // ilog("Request for item ${id}", ("id", id));
          if( id.item_type == graphene::net::block_message_type )
          {
-            auto opt_block = _chain_db->fetch_block_by_id(id.item_hash);
-            if( !opt_block )
+            auto packed_block = _chain_db->fetch_packed_block_by_id(id.item_hash);
+            if( !packed_block )
                elog("Couldn't find block ${id} -- corresponding ID in our chain is ${id2}",
                     ("id", id.item_hash)("id2", _chain_db->get_block_id_for_num(block_header::num_from_id(id.item_hash))));
-            FC_ASSERT( opt_block.valid() );
-            // ilog("Serving up block #${num}", ("num", opt_block->block_num()));
-            return block_message(std::move(*opt_block));
+            FC_ASSERT( packed_block );
+            // a block_message is the packed block followed by its id, which is exactly what was requested
+            message result;
+            result.msg_type = block_message::type;
+            result.data.reserve( packed_block->size() + sizeof(block_id_type) );
+            result.data.insert( result.data.end(), packed_block->begin(), packed_block->end() );
+            const auto packed_id = fc::raw::pack( id.item_hash );
+            result.data.insert( result.data.end(), packed_id.begin(), packed_id.end() );
+            result.size = (uint32_t)result.data.size();
+            return result;
          }
          return trx_message( _chain_db->get_recent_transaction( id.item_hash ) );
       } FC_CAPTURE_AND_RETHROW( (id) ) }
@@ -757,19 +865,22 @@ namespace detail {
           // true_high_block_num is the ending block number after the network code appends any item ids it 
           // knows about that we don't
           uint32_t true_high_block_num = high_block_num + number_of_blocks_after_reference_point;
+          std::vector<uint32_t> synopsis_block_nums;
           do
           {
-            // for each block in the synopsis, figure out where to pull the block id from.
-            // if it's <= non_fork_high_block_num, we grab it from the main blockchain;
-            // if it's not, we pull it from the fork history
-            if (low_block_num <= non_fork_high_block_num)
-              synopsis.push_back(_chain_db->get_block_id_for_num(low_block_num));
-            else
-              synopsis.push_back(fork_history[low_block_num - non_fork_high_block_num - 1]);
+            synopsis_block_nums.push_back(low_block_num);
             low_block_num += (true_high_block_num - low_block_num + 2) / 2;
           }
           while (low_block_num <= high_block_num);
 
+          // for each block in the synopsis, figure out where to pull the block id from.
+          // if it's <= non_fork_high_block_num, we grab it from the main blockchain;
+          // if it's not, we pull it from the fork history
+          auto fork_begin = std::upper_bound(synopsis_block_nums.begin(), synopsis_block_nums.end(), non_fork_high_block_num);
+          synopsis = _chain_db->get_block_ids_for_nums(std::vector<uint32_t>(synopsis_block_nums.begin(), fork_begin));
+          for (auto itr = fork_begin; itr != synopsis_block_nums.end(); ++itr)
+            synopsis.push_back(fork_history[*itr - non_fork_high_block_num - 1]);
+
           idump((synopsis));
           return synopsis;
       } FC_CAPTURE_AND_RETHROW() }
@@ -850,6 +961,9 @@ namespace detail {
       std::map<string, std::shared_ptr<abstract_plugin>> _plugins;
 
       bool _is_finished_syncing = false;
+
+      vector< std::shared_ptr<fc::thread> >              _api_threads;
+      uint32_t                                           _next_api_thread = 0;
    };
 
 }
@@ -885,6 +999,20 @@ void application::set_program_options(boost::program_options::options_descriptio
          ("genesis-json", bpo::value<boost::filesystem::path>(), "File to read Genesis State from")
          ("dbg-init-key", bpo::value<string>(), "Block signing key to use for init witnesses, overrides genesis file")
          ("api-access", bpo::value<boost::filesystem::path>(), "JSON file specifying API permissions")
+         ("state-checkpoint-interval", bpo::value<uint32_t>()->default_value(100), "Save the objects changed by recent blocks every N blocks so an unclean shutdown does not require a replay (0 to disable)")
+         ("state-checkpoints-per-merge", bpo::value<uint32_t>()->default_value(100), "Number of state checkpoints to write before merging them into one file in the background")
+         ("block-log-sync-blocks", bpo::value<uint32_t>()->default_value(0), "Sync the block log to disk every N blocks stored (0 to disable)")
+         ("block-log-sync-interval", bpo::value<uint32_t>()->default_value(1000), "Sync the block log to disk when a block is stored this many milliseconds after the last sync (0 to disable)")
+         ("index-statistics-interval", bpo::value<uint32_t>()->default_value(0), "Number of blocks between log lines reporting the size and activity of every object index (0 to disable)")
+         ("state-digest", bpo::value<bool>()->default_value(false), "Maintain a digest of the chain state after every block, for comparing state between nodes")
+         ("block-cache-size", bpo::value<uint64_t>()->default_value(64), "Megabytes of recently read blocks to keep decoded in memory for syncing peers and API clients (0 to disable)")
+         ("block-cache-packed", bpo::value<bool>()->default_value(true), "Also keep the serialized form of cached blocks, so that serving them to peers does not serialize them again")
+         ("transaction-id-index", bpo::value<bool>()->default_value(false), "Index the transactions of the blockchain by ID, so that get_transaction_by_id can find any of them")
+         ("api-threads", bpo::value<uint32_t>()->default_value(0), "Number of threads serving object lookups from read-only snapshots of the chain state (0 to serve them on the main thread)")
+         ("signature-recovery-threads", bpo::value<uint32_t>()->default_value(0), "Number of threads recovering the signing keys of transactions before they are checked when producing blocks or with force-validate (0 to recover them on the main thread)")
+         ("signature-cache-size", bpo::value<uint32_t>()->default_value(100000), "Number of signatures to remember the recovered public key of until their transaction expires, so that pending transactions checked again do not recover them again (0 to disable)")
+         ("pending-transactions-size", bpo::value<uint64_t>()->default_value(64), "Megabytes of pending transactions to keep, evicting the ones paying the least fee per byte when full (0 for no limit)")
+         ("pending-transactions-per-account", bpo::value<uint32_t>()->default_value(1000), "Number of pending transactions any one account may pay the fees of (0 for no limit)")
          ;
    command_line_options.add(configuration_file_options);
    command_line_options.add_options()
@@ -894,6 +1022,8 @@ void application::set_program_options(boost::program_options::options_descriptio
           "invalid file is found, it will be replaced with an example Genesis State.")
          ("replay-blockchain", "Rebuild object graph by replaying all blocks")
          ("resync-blockchain", "Delete all blocks and re-sync with network from scratch")
+         ("create-snapshot", bpo::value<boost::filesystem::path>(), "Save the chain state at the last irreversible block to a new directory at this path, then exit")
+         ("import-snapshot", bpo::value<boost::filesystem::path>(), "Replace the chain state by a snapshot saved with create-snapshot, then replay the blocks after it that are in the block log")
          ("force-validate", "Force validation of all transactions")
          ("genesis-timestamp", bpo::value<uint32_t>(), "Replace timestamp from genesis.json with current time plus this many seconds (experts only!)")
          ;
@@ -975,6 +1105,13 @@ void application::set_api_access_info(const string& username, api_access_info&&
    my->set_api_access_info(username, std::move(permissions));
 }
 
+fc::thread* application::get_api_thread()
+{
+   if( my->_api_threads.empty() )
+      return nullptr;
+   return my->_api_threads[ my->_next_api_thread++ % my->_api_threads.size() ].get();
+}
+
 bool application::is_finished_syncing() const
 {
    return my->_is_finished_syncing;
@@ -56,6 +56,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       optional<block_header> get_block_header(uint32_t block_num)const;
       optional<signed_block> get_block(uint32_t block_num)const;
       processed_transaction get_transaction( uint32_t block_num, uint32_t trx_in_block )const;
+      optional<located_transaction> get_transaction_by_id( const transaction_id_type& id )const;
 
       // Globals
       chain_property_object get_chain_properties()const;
@@ -63,6 +64,9 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       fc::variant_object get_config()const;
       chain_id_type get_chain_id()const;
       dynamic_global_property_object get_dynamic_global_properties()const;
+      vector<index_statistics> get_index_statistics()const;
+      fc::sha256 get_head_state_digest()const;
+      block_cache_statistics get_block_cache_statistics()const;
 
       // Keys
       vector<vector<account_id_type>> get_key_references( vector<public_key_type> key )const;
@@ -127,6 +131,26 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       vector<blinded_balance_object> get_blinded_balances( const flat_set<commitment_type>& commitments )const;
 
    //private:
+      typedef std::function<const object*(object_id_type)> object_finder;
+
+      /**
+       *  Calls l with a function that finds objects by ID.  When a read thread is configured and the database has
+       *  published a read view, l runs on the read thread against that view; otherwise it runs here against the
+       *  live database.  l must not touch any other state of this API.
+       */
+      template<typename Lambda>
+      auto with_read_view( Lambda&& l )const -> decltype( l( object_finder() ) )
+      {
+         std::shared_ptr<const object_read_view> view;
+         if( _read_thread != nullptr )
+            view = _db.get_read_view();
+         if( !view )
+            return l( object_finder( [this]( object_id_type id ) { return _db.find_object( id ); } ) );
+         return _read_thread->async( [&l,view]() {
+            return l( object_finder( [&view]( object_id_type id ) { return view->find( id ); } ) );
+         }, "database_api read" ).wait();
+      }
+
       template<typename T>
       void subscribe_to_item( const T& i )const
       {
@@ -168,6 +192,7 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
       boost::signals2::scoped_connection                                                                                           _pending_trx_connection;
       map< pair<asset_id_type,asset_id_type>, std::function<void(const variant&)> >      _market_subscriptions;
       graphene::chain::database&                                                                                                            _db;
+      fc::thread*                                                                                                                           _read_thread = nullptr;
 };
 
 //////////////////////////////////////////////////////////////////////
@@ -176,8 +201,11 @@ class database_api_impl : public std::enable_shared_from_this<database_api_impl>
 //                                                                  //
 //////////////////////////////////////////////////////////////////////
 
-database_api::database_api( graphene::chain::database& db )
-   : my( new database_api_impl( db ) ) {}
+database_api::database_api( graphene::chain::database& db, fc::thread* read_thread )
+   : my( new database_api_impl( db ) )
+{
+   my->_read_thread = read_thread;
+}
 
 database_api::~database_api() {}
 
@@ -229,17 +257,18 @@ fc::variants database_api_impl::get_objects(const vector<object_id_type>& ids)co
       elog( "getObjects without subscribe callback??" );
    }
 
-   fc::variants result;
-   result.reserve(ids.size());
+   return with_read_view( [&ids]( const object_finder& find ) {
+      fc::variants result;
+      result.reserve(ids.size());
 
-   std::transform(ids.begin(), ids.end(), std::back_inserter(result),
-                  [this](object_id_type id) -> fc::variant {
-      if(auto obj = _db.find_object(id))
-         return obj->to_variant();
-      return {};
+      std::transform(ids.begin(), ids.end(), std::back_inserter(result),
+                     [&find](object_id_type id) -> fc::variant {
+         if(auto obj = find(id))
+            return obj->to_variant();
+         return {};
+      });
+      return result;
    });
-
-   return result;
 }
 
 //////////////////////////////////////////////////////////////////////
@@ -342,6 +371,27 @@ optional<signed_transaction> database_api::get_recent_transaction_by_id( const t
    }
 }
 
+optional<located_transaction> database_api::get_transaction_by_id( const transaction_id_type& id )const
+{
+   return my->get_transaction_by_id( id );
+}
+
+optional<located_transaction> database_api_impl::get_transaction_by_id( const transaction_id_type& id )const
+{
+   optional<transaction_location> loc = _db.find_transaction( id );
+   if( !loc )
+      return optional<located_transaction>();
+   auto b = _db.fetch_shared_block_by_number( loc->block_num );
+   // the block may have been popped since it was found
+   if( !b || loc->trx_in_block >= b->transactions.size() )
+      return optional<located_transaction>();
+   located_transaction result;
+   result.block_num = loc->block_num;
+   result.trx_in_block = loc->trx_in_block;
+   result.trx = b->transactions[loc->trx_in_block];
+   return result;
+}
+
 processed_transaction database_api_impl::get_transaction(uint32_t block_num, uint32_t trx_num)const
 {
    auto opt_block = _db.fetch_block_by_number(block_num);
@@ -406,6 +456,36 @@ dynamic_global_property_object database_api_impl::get_dynamic_global_properties(
    return _db.get(dynamic_global_property_id_type());
 }
 
+vector<index_statistics> database_api::get_index_statistics()const
+{
+   return my->get_index_statistics();
+}
+
+vector<index_statistics> database_api_impl::get_index_statistics()const
+{
+   return _db.get_index_statistics();
+}
+
+fc::sha256 database_api::get_head_state_digest()const
+{
+   return my->get_head_state_digest();
+}
+
+fc::sha256 database_api_impl::get_head_state_digest()const
+{
+   return _db.head_state_digest();
+}
+
+block_cache_statistics database_api::get_block_cache_statistics()const
+{
+   return my->get_block_cache_statistics();
+}
+
+block_cache_statistics database_api_impl::get_block_cache_statistics()const
+{
+   return _db.get_block_cache_statistics();
+}
+
 //////////////////////////////////////////////////////////////////////
 //                                                                  //
 // Keys                                                             //
@@ -489,16 +569,19 @@ vector<optional<account_object>> database_api::get_accounts(const vector<account
 
 vector<optional<account_object>> database_api_impl::get_accounts(const vector<account_id_type>& account_ids)const
 {
-   vector<optional<account_object>> result; result.reserve(account_ids.size());
-   std::transform(account_ids.begin(), account_ids.end(), std::back_inserter(result),
-                  [this](account_id_type id) -> optional<account_object> {
-      if(auto o = _db.find(id))
-      {
-         subscribe_to_item( id );
-         return *o;
-      }
-      return {};
+   auto result = with_read_view( [&account_ids]( const object_finder& find ) {
+      vector<optional<account_object>> result; result.reserve(account_ids.size());
+      std::transform(account_ids.begin(), account_ids.end(), std::back_inserter(result),
+                     [&find](account_id_type id) -> optional<account_object> {
+         if(auto o = find(id))
+            return static_cast<const account_object&>(*o);
+         return {};
+      });
+      return result;
    });
+   for( size_t i = 0; i < result.size(); ++i )
+      if( result[i] )
+         subscribe_to_item( account_ids[i] );
    return result;
 }
 
@@ -808,16 +891,19 @@ vector<optional<asset_object>> database_api::get_assets(const vector<asset_id_ty
 
 vector<optional<asset_object>> database_api_impl::get_assets(const vector<asset_id_type>& asset_ids)const
 {
-   vector<optional<asset_object>> result; result.reserve(asset_ids.size());
-   std::transform(asset_ids.begin(), asset_ids.end(), std::back_inserter(result),
-                  [this](asset_id_type id) -> optional<asset_object> {
-      if(auto o = _db.find(id))
-      {
-         subscribe_to_item( id );
-         return *o;
-      }
-      return {};
+   auto result = with_read_view( [&asset_ids]( const object_finder& find ) {
+      vector<optional<asset_object>> result; result.reserve(asset_ids.size());
+      std::transform(asset_ids.begin(), asset_ids.end(), std::back_inserter(result),
+                     [&find](asset_id_type id) -> optional<asset_object> {
+         if(auto o = find(id))
+            return static_cast<const asset_object&>(*o);
+         return {};
+      });
+      return result;
    });
+   for( size_t i = 0; i < result.size(); ++i )
+      if( result[i] )
+         subscribe_to_item( asset_ids[i] );
    return result;
 }
 
@@ -1014,14 +1100,16 @@ vector<worker_object> database_api::get_workers_by_account(account_id_type accou
 
 vector<optional<witness_object>> database_api_impl::get_witnesses(const vector<witness_id_type>& witness_ids)const
 {
-   vector<optional<witness_object>> result; result.reserve(witness_ids.size());
-   std::transform(witness_ids.begin(), witness_ids.end(), std::back_inserter(result),
-                  [this](witness_id_type id) -> optional<witness_object> {
-      if(auto o = _db.find(id))
-         return *o;
-      return {};
+   return with_read_view( [&witness_ids]( const object_finder& find ) {
+      vector<optional<witness_object>> result; result.reserve(witness_ids.size());
+      std::transform(witness_ids.begin(), witness_ids.end(), std::back_inserter(result),
+                     [&find](witness_id_type id) -> optional<witness_object> {
+         if(auto o = find(id))
+            return static_cast<const witness_object&>(*o);
+         return {};
+      });
+      return result;
    });
-   return result;
 }
 
 fc::optional<witness_object> database_api::get_witness_by_account(account_id_type account)const
@@ -1089,14 +1177,16 @@ vector<optional<committee_member_object>> database_api::get_committee_members(co
 
 vector<optional<committee_member_object>> database_api_impl::get_committee_members(const vector<committee_member_id_type>& committee_member_ids)const
 {
-   vector<optional<committee_member_object>> result; result.reserve(committee_member_ids.size());
-   std::transform(committee_member_ids.begin(), committee_member_ids.end(), std::back_inserter(result),
-                  [this](committee_member_id_type id) -> optional<committee_member_object> {
-      if(auto o = _db.find(id))
-         return *o;
-      return {};
+   return with_read_view( [&committee_member_ids]( const object_finder& find ) {
+      vector<optional<committee_member_object>> result; result.reserve(committee_member_ids.size());
+      std::transform(committee_member_ids.begin(), committee_member_ids.end(), std::back_inserter(result),
+                     [&find](committee_member_id_type id) -> optional<committee_member_object> {
+         if(auto o = find(id))
+            return static_cast<const committee_member_object&>(*o);
+         return {};
+      });
+      return result;
    });
-   return result;
 }
 
 fc::optional<committee_member_object> database_api::get_committee_member_by_account(account_id_type account)const
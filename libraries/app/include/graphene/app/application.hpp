@@ -24,6 +24,8 @@
 #include <graphene/net/node.hpp>
 #include <graphene/chain/database.hpp>
 
+#include <fc/thread/thread.hpp>
+
 #include <boost/program_options.hpp>
 
 namespace graphene { namespace app {
@@ -81,6 +83,12 @@ namespace graphene { namespace app {
          fc::optional< api_access_info > get_api_access_info( const string& username )const;
          void set_api_access_info(const string& username, api_access_info&& permissions);
 
+         /**
+          * @return the next thread of the pool that serves reads from the chain database's published read views, or
+          * nullptr if API reads should run on the main thread
+          */
+         fc::thread* get_api_thread();
+
          bool is_finished_syncing()const;
          /// Emitted when syncing finishes (is_finished_syncing will return true)
          boost::signals2::signal<void()> syncing_finished;
@@ -43,6 +43,7 @@
 #include <fc/variant_object.hpp>
 
 #include <fc/network/ip.hpp>
+#include <fc/thread/thread.hpp>
 
 #include <boost/container/flat_set.hpp>
 
@@ -58,6 +59,14 @@ using namespace std;
 
 class database_api_impl;
 
+/** a transaction of the chain together with its position in it */
+struct located_transaction
+{
+   uint32_t              block_num = 0;
+   uint16_t              trx_in_block = 0;
+   processed_transaction trx;
+};
+
 /**
  * @brief The database_api class implements the RPC API for the chain database.
  *
@@ -68,7 +77,11 @@ class database_api_impl;
 class database_api
 {
    public:
-      database_api(graphene::chain::database& db);
+      /**
+       * @param read_thread if set, lookups by object ID are served on this thread from the last read view published
+       * by the database, so that they do not compete with block application on the main thread
+       */
+      database_api(graphene::chain::database& db, fc::thread* read_thread = nullptr);
       ~database_api();
 
       /////////////
@@ -128,6 +141,12 @@ class database_api
        */
       optional<signed_transaction> get_recent_transaction_by_id( const transaction_id_type& id )const;
 
+      /**
+       * @return the transaction with the given ID and the block that includes it, or null if it is not in the
+       * blockchain.  Transactions are only found by ID when the node runs with transaction-id-index enabled.
+       */
+      optional<located_transaction> get_transaction_by_id( const transaction_id_type& id )const;
+
       /////////////
       // Globals //
       /////////////
@@ -157,6 +176,28 @@ class database_api
        */
       dynamic_global_property_object get_dynamic_global_properties()const;
 
+      /**
+       * @brief Retrieve the size of every object index and the number of creates, modifies and removes it has seen
+       *
+       * The activity counters accumulate from the time the node started, so rates are found by comparing the
+       * results of two calls against the head block numbers at which they were made.
+       */
+      vector<index_statistics> get_index_statistics()const;
+
+      /**
+       * @brief Retrieve the digest of the chain state after the head block, as returned by
+       * database::head_state_digest
+       *
+       * Nodes at the same head block return the same digest exactly when their states agree.  The digest is
+       * all zero unless the node runs with state-digest enabled.
+       */
+      fc::sha256 get_head_state_digest()const;
+
+      /**
+       * @brief Retrieve the size of the cache of decoded blocks and its hit and miss counts since the node started
+       */
+      block_cache_statistics get_block_cache_statistics()const;
+
       //////////
       // Keys //
       //////////
@@ -473,6 +514,8 @@ class database_api
 
 } }
 
+FC_REFLECT( graphene::app::located_transaction, (block_num)(trx_in_block)(trx) )
+
 FC_API(graphene::app::database_api,
    // Objects
    (get_objects)
@@ -488,6 +531,7 @@ FC_API(graphene::app::database_api,
    (get_block)
    (get_transaction)
    (get_recent_transaction_by_id)
+   (get_transaction_by_id)
 
    // Globals
    (get_chain_properties)
@@ -495,6 +539,9 @@ FC_API(graphene::app::database_api,
    (get_config)
    (get_chain_id)
    (get_dynamic_global_properties)
+   (get_index_statistics)
+   (get_head_state_digest)
+   (get_block_cache_statistics)
 
    // Keys
    (get_key_references)
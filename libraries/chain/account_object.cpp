@@ -24,6 +24,8 @@
 #include <graphene/chain/hardfork.hpp>
 #include <fc/uint128.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace chain {
 
 share_type cut_fee(share_type a, uint16_t p)
@@ -295,6 +297,56 @@ void account_member_index::object_modified(const object& after)
 
 }
 
+void account_member_index::clear()
+{
+   account_to_account_memberships.clear();
+   account_to_key_memberships.clear();
+   account_to_address_memberships.clear();
+}
+
+namespace {
+   /** fills memberships from (member, account) pairs, sorting them first so every insert is at the end */
+   template<typename Key>
+   void build_memberships( map< Key, set<account_id_type> >& memberships, vector< std::pair<Key, account_id_type> >& entries )
+   {
+      std::sort( entries.begin(), entries.end() );
+      auto itr = entries.begin();
+      while( itr != entries.end() )
+      {
+         const Key& key = itr->first;
+         auto& accounts = memberships.emplace_hint( memberships.end(), key, set<account_id_type>() )->second;
+         do {
+            accounts.emplace_hint( accounts.end(), itr->second );
+         } while( ++itr != entries.end() && !( key < itr->first ) );
+      }
+   }
+}
+
+void account_member_index::rebuild( const graphene::db::index& accounts )
+{
+   clear();
+   vector< std::pair<account_id_type, account_id_type> > account_entries;
+   vector< std::pair<public_key_type, account_id_type> > key_entries;
+   vector< std::pair<address, account_id_type> >         address_entries;
+   accounts.inspect_all_objects( [&]( const object& obj ) {
+      assert( dynamic_cast<const account_object*>(&obj) ); // for debug only
+      const account_object& a = static_cast<const account_object&>(obj);
+      const account_id_type id = a.id;
+      // duplicates between the owner and active authorities are dropped when the sets are built
+      for( const auto& auth : a.owner.account_auths )   account_entries.emplace_back( auth.first, id );
+      for( const auto& auth : a.active.account_auths )  account_entries.emplace_back( auth.first, id );
+      for( const auto& auth : a.owner.key_auths )       key_entries.emplace_back( auth.first, id );
+      for( const auto& auth : a.active.key_auths )      key_entries.emplace_back( auth.first, id );
+      key_entries.emplace_back( a.options.memo_key, id );
+      for( const auto& auth : a.owner.address_auths )   address_entries.emplace_back( auth.first, id );
+      for( const auto& auth : a.active.address_auths )  address_entries.emplace_back( auth.first, id );
+      address_entries.emplace_back( address( a.options.memo_key ), id );
+   });
+   build_memberships( account_to_account_memberships, account_entries );
+   build_memberships( account_to_key_memberships, key_entries );
+   build_memberships( account_to_address_memberships, address_entries );
+}
+
 void account_referrer_index::object_inserted( const object& obj )
 {
 }
@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/block_cache.hpp>
+
+namespace graphene { namespace chain {
+
+void block_cache::set_capacity( uint64_t bytes, bool keep_packed )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = bytes;
+   if( _keep_packed != keep_packed )
+   {
+      _entries.clear();
+      _bytes = 0;
+   }
+   _keep_packed = keep_packed;
+   evict();
+}
+
+bool block_cache::enabled()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _capacity > 0;
+}
+
+bool block_cache::keeps_packed()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _keep_packed;
+}
+
+block_cache::block_ptr block_cache::get( const block_id_type& id )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto& by_id_idx = _entries.get<by_id>();
+   auto itr = by_id_idx.find( id );
+   if( itr == by_id_idx.end() )
+   {
+      ++_misses;
+      return block_ptr();
+   }
+   ++_hits;
+   _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+   return itr->block;
+}
+
+block_cache::packed_ptr block_cache::get_packed( const block_id_type& id )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto& by_id_idx = _entries.get<by_id>();
+   auto itr = by_id_idx.find( id );
+   if( itr == by_id_idx.end() || !itr->packed )
+   {
+      ++_misses;
+      return packed_ptr();
+   }
+   ++_hits;
+   _entries.relocate( _entries.begin(), _entries.project<0>( itr ) );
+   return itr->packed;
+}
+
+void block_cache::put( const block_id_type& id, const block_ptr& block, const packed_ptr& packed )
+{
+   FC_ASSERT( block && packed );
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity == 0 )
+      return;
+
+   // the packed size stands in for the size of the decoded block
+   entry e{ id, block, _keep_packed ? packed : packed_ptr(), packed->size() * ( _keep_packed ? 2 : 1 ) };
+   if( e.bytes > _capacity )
+      return;
+
+   auto& by_id_idx = _entries.get<by_id>();
+   auto itr = by_id_idx.find( id );
+   if( itr != by_id_idx.end() )
+   {
+      _bytes -= itr->bytes;
+      by_id_idx.erase( itr );
+   }
+   _entries.push_front( std::move( e ) );
+   _bytes += _entries.front().bytes;
+   evict();
+}
+
+void block_cache::remove( const block_id_type& id )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto& by_id_idx = _entries.get<by_id>();
+   auto itr = by_id_idx.find( id );
+   if( itr == by_id_idx.end() )
+      return;
+   _bytes -= itr->bytes;
+   by_id_idx.erase( itr );
+}
+
+void block_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _entries.clear();
+   _bytes = 0;
+}
+
+void block_cache::evict()
+{
+   while( _bytes > _capacity && !_entries.empty() )
+   {
+      _bytes -= _entries.back().bytes;
+      _entries.pop_back();
+      ++_evictions;
+   }
+}
+
+block_cache_statistics block_cache::get_statistics()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   block_cache_statistics s;
+   s.capacity    = _capacity;
+   s.bytes       = _bytes;
+   s.block_count = _entries.size();
+   s.hits        = _hits;
+   s.misses      = _misses;
+   s.evictions   = _evictions;
+   return s;
+}
+
+} } // graphene::chain
@@ -21,56 +21,807 @@
 #include <graphene/chain/block_database.hpp>
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <fc/io/raw.hpp>
+#include <fc/interprocess/file_mapping.hpp>
 #include <fc/smart_ref_impl.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <zlib.h>
+
+#ifdef WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
 
 namespace graphene { namespace chain {
 
 struct index_entry
 {
+   /** offset of the packed block in the uncompressed contents of its segment */
    uint64_t      block_pos = 0;
    uint32_t      block_size = 0;
+   /** crc32 of the packed block and the other fields, 0 for entries written before checksums were kept */
+   uint32_t      checksum = 0;
    block_id_type block_id;
 };
+
+/** the entries of the index written by older versions, which had no checksum */
+struct unchecked_index_entry
+{
+   uint64_t      block_pos = 0;
+   uint32_t      block_size = 0;
+   block_id_type block_id;
+};
+
+/** a run of whole blocks of a sealed segment that is compressed on its own */
+struct segment_frame
+{
+   uint64_t raw_offset = 0;
+   uint64_t offset = 0;
+   uint32_t raw_size = 0;
+   uint32_t size = 0;
+};
+
+struct block_segment
+{
+   ~block_segment();
+
+   fc::path                path;
+   int                     fd = -1;
+   bool                    sealed = false;
+   /** end of the uncompressed contents, where the next block of a raw segment is appended */
+   uint64_t                size = 0;
+   /** the seek table of a sealed segment, ordered by raw_offset */
+   vector<segment_frame>   frames;
+};
  }}
-FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(block_id) );
+FC_REFLECT( graphene::chain::index_entry, (block_pos)(block_size)(checksum)(block_id) );
+FC_REFLECT( graphene::chain::segment_frame, (raw_offset)(offset)(raw_size)(size) );
 
 namespace graphene { namespace chain {
 
+namespace {
+   /** the index file is mapped in chunks of this many entries, so that growing it never moves mapped entries */
+   const uint32_t entries_per_chunk = 1 << 16;
+   const uint64_t chunk_bytes       = uint64_t(entries_per_chunk) * sizeof(index_entry);
+
+   /** sealed segments are compressed in frames of at least this many bytes */
+   const uint64_t frame_bytes       = 64 * 1024;
+   /** ends every sealed segment, after the offset of its seek table */
+   const uint64_t sealed_magic      = 0x474c4f4b5a4c4f47ull;
+
+   int open_file( const fc::path& p )
+   {
+#ifdef WIN32
+      int fd = _open( p.generic_string().c_str(), _O_RDWR | _O_CREAT | _O_BINARY, _S_IREAD | _S_IWRITE );
+#else
+      int fd = ::open( p.generic_string().c_str(), O_RDWR | O_CREAT, 0644 );
+#endif
+      FC_ASSERT( fd >= 0, "Unable to open ${file}: ${error}", ("file",p)("error",strerror(errno)) );
+      return fd;
+   }
+
+   void close_file( int fd )
+   {
+#ifdef WIN32
+      _close( fd );
+#else
+      ::close( fd );
+#endif
+   }
+
+   /** waits until everything written to fd is on disk */
+   void sync_file( int fd )
+   {
+#ifdef WIN32
+      FC_ASSERT( _commit( fd ) == 0, "Error syncing block log: ${error}", ("error",strerror(errno)) );
+#else
+      int r;
+      do { r = ::fsync( fd ); } while( r < 0 && errno == EINTR );
+      FC_ASSERT( r == 0, "Error syncing block log: ${error}", ("error",strerror(errno)) );
+#endif
+   }
+
+   uint32_t entry_checksum( const index_entry& e, const char* data )
+   {
+      uLong crc = crc32( 0, (const Bytef*)data, e.block_size );
+      crc = crc32( crc, (const Bytef*)&e.block_pos, sizeof(e.block_pos) );
+      crc = crc32( crc, (const Bytef*)&e.block_size, sizeof(e.block_size) );
+      crc = crc32( crc, (const Bytef*)&e.block_id, sizeof(e.block_id) );
+      // 0 marks an entry without a checksum
+      return crc == 0 ? 1 : uint32_t( crc );
+   }
+
+   /** reads exactly size bytes at pos without moving any shared file position, so it is safe from any thread */
+   void read_at( int fd, char* data, size_t size, uint64_t pos )
+   {
+      while( size > 0 )
+      {
+#ifdef WIN32
+         OVERLAPPED o = {};
+         o.Offset     = DWORD( pos );
+         o.OffsetHigh = DWORD( pos >> 32 );
+         DWORD n = 0;
+         FC_ASSERT( ReadFile( (HANDLE)_get_osfhandle( fd ), data, DWORD( size ), &n, &o ) && n > 0,
+                    "Error reading block log at ${pos}", ("pos",pos) );
+#else
+         ssize_t n = ::pread( fd, data, size, pos );
+         if( n < 0 && errno == EINTR ) continue;
+         FC_ASSERT( n > 0, "Error reading block log at ${pos}: ${error}", ("pos",pos)("error",n < 0 ? strerror(errno) : "end of file") );
+#endif
+         data += n;
+         size -= n;
+         pos  += n;
+      }
+   }
+
+   void write_at( int fd, const char* data, size_t size, uint64_t pos )
+   {
+      while( size > 0 )
+      {
+#ifdef WIN32
+         OVERLAPPED o = {};
+         o.Offset     = DWORD( pos );
+         o.OffsetHigh = DWORD( pos >> 32 );
+         DWORD n = 0;
+         FC_ASSERT( WriteFile( (HANDLE)_get_osfhandle( fd ), data, DWORD( size ), &n, &o ) && n > 0,
+                    "Error writing block log at ${pos}", ("pos",pos) );
+#else
+         ssize_t n = ::pwrite( fd, data, size, pos );
+         if( n < 0 && errno == EINTR ) continue;
+         FC_ASSERT( n > 0, "Error writing block log at ${pos}: ${error}", ("pos",pos)("error",strerror(errno)) );
+#endif
+         data += n;
+         size -= n;
+         pos  += n;
+      }
+   }
+
+   vector<char> inflate_frame( int fd, const segment_frame& f )
+   {
+      vector<char> compressed( f.size );
+      read_at( fd, compressed.data(), compressed.size(), f.offset );
+      vector<char> data( f.raw_size );
+      uLongf data_size = data.size();
+      int r = uncompress( (Bytef*)data.data(), &data_size, (const Bytef*)compressed.data(), compressed.size() );
+      FC_ASSERT( r == Z_OK && data_size == data.size(), "Corrupt frame in block log at ${pos}", ("pos",f.offset) );
+      return data;
+   }
+
+   /** reads the seek table of a sealed segment */
+   vector<segment_frame> read_seek_table( int fd, uint64_t file_size )
+   {
+      FC_ASSERT( file_size >= 2 * sizeof(uint64_t), "Truncated sealed block log segment" );
+      uint64_t footer[2];
+      read_at( fd, (char*)footer, sizeof(footer), file_size - sizeof(footer) );
+      FC_ASSERT( footer[1] == sealed_magic && footer[0] <= file_size - sizeof(footer),
+                 "Sealed block log segment has no seek table" );
+      vector<char> table( file_size - sizeof(footer) - footer[0] );
+      read_at( fd, table.data(), table.size(), footer[0] );
+      return fc::raw::unpack< vector<segment_frame> >( table );
+   }
+
+   /**
+    * compresses the given bodies of a raw segment into a sealed segment at path, which is written to tmp first,
+    * and only reads from the raw segment, so it may run on any thread
+    */
+   std::shared_ptr<block_segment> write_sealed_segment( const block_segment& raw,
+                                                        const vector< std::pair<uint64_t, uint32_t> >& bodies,
+                                                        const fc::path& tmp, const fc::path& path )
+   { try {
+      std::shared_ptr<block_segment> sealed = std::make_shared<block_segment>();
+      sealed->path   = path;
+      sealed->sealed = true;
+      sealed->size   = raw.size;
+
+      int fd = open_file( tmp );
+      try
+      {
+         uint64_t offset = 0;
+         vector<char> data;
+         vector<char> compressed;
+         for( auto b = bodies.begin(); b != bodies.end(); )
+         {
+            segment_frame f;
+            f.raw_offset = b->first;
+            uint64_t end = b->first;
+            for( ; b != bodies.end() && ( end == f.raw_offset || end - f.raw_offset < frame_bytes ); ++b )
+               end = std::max( end, b->first + b->second );
+            f.raw_size = end - f.raw_offset;
+
+            data.resize( f.raw_size );
+            read_at( raw.fd, data.data(), data.size(), f.raw_offset );
+            uLongf compressed_size = compressBound( data.size() );
+            compressed.resize( compressed_size );
+            FC_ASSERT( compress2( (Bytef*)compressed.data(), &compressed_size, (const Bytef*)data.data(), data.size(),
+                                  Z_DEFAULT_COMPRESSION ) == Z_OK );
+            f.offset = offset;
+            f.size   = compressed_size;
+            write_at( fd, compressed.data(), f.size, offset );
+            offset += f.size;
+            sealed->frames.push_back( f );
+         }
+
+         const vector<char> table = fc::raw::pack( sealed->frames );
+         write_at( fd, table.data(), table.size(), offset );
+         const uint64_t footer[2] = { offset, sealed_magic };
+         write_at( fd, (const char*)footer, sizeof(footer), offset + table.size() );
+         // the sealed file must be complete on disk before it replaces the raw one
+         sync_file( fd );
+      }
+      catch( ... )
+      {
+         close_file( fd );
+         fc::remove( tmp );
+         throw;
+      }
+      close_file( fd );
+      fc::rename( tmp, path );
+      sealed->fd = open_file( path );
+      return sealed;
+   } FC_CAPTURE_AND_RETHROW( (path) ) }
+}
+
+block_segment::~block_segment()
+{
+   if( fd >= 0 )
+      close_file( fd );
+}
+
+block_database::block_database( uint32_t blocks_per_segment, uint32_t seal_delay )
+   :_blocks_per_segment( blocks_per_segment ),_seal_delay( seal_delay )
+{
+   FC_ASSERT( blocks_per_segment > 0 );
+}
+
+block_database::~block_database()
+{
+   close();
+}
+
 void block_database::open( const fc::path& dbdir )
 { try {
+   close();
    fc::create_directories(dbdir);
-   _block_num_to_pos.exceptions(std::ios_base::failbit | std::ios_base::badbit);
-   _blocks.exceptions(std::ios_base::failbit | std::ios_base::badbit);
 
-   if( !fc::exists( dbdir/"index" ) )
+   if( fc::exists( dbdir/"blocks" ) )
+      convert_legacy_log( dbdir );
+   else if( fc::exists( dbdir/"index" ) )
+      fc::remove( dbdir/"index" ); // left behind by a conversion that was interrupted after its last step
+
+   _dir = dbdir/"segments";
+   fc::create_directories( _dir );
+   if( fc::exists( _dir/"index" ) )
+      convert_unchecked_index();
+
+   open_index();
+   open_segments();
+   recover_tail();
+} FC_CAPTURE_AND_RETHROW( (dbdir) ) }
+
+void block_database::open_index()
+{
+   // the index file always spans whole chunks, the entries past the last block stored are all zero
+   const fc::path index_path = _dir/"entries";
+   if( !fc::exists( index_path ) )
+      std::ofstream( index_path.generic_string().c_str(), std::ofstream::binary );
+   const uint64_t index_size = fc::file_size( index_path );
+   const uint64_t chunk_count = std::max<uint64_t>( 1, ( index_size + chunk_bytes - 1 ) / chunk_bytes );
+   if( index_size != chunk_count * chunk_bytes )
+      fc::resize_file( index_path, chunk_count * chunk_bytes );
+   _index_file.reset( new fc::file_mapping( index_path.generic_string().c_str(), fc::read_write ) );
+   _index_fd = open_file( index_path );
+   for( uint64_t i = 0; i < chunk_count; ++i )
+      _index_chunks.emplace_back( new fc::mapped_region( *_index_file, fc::read_write, i * chunk_bytes, chunk_bytes ) );
+
+   _entry_count = uint32_t( chunk_count * entries_per_chunk );
+   while( _entry_count > 0 && mutable_entry( _entry_count - 1 ).block_id == block_id_type() )
+      --_entry_count;
+
+   // a log that has no record of its last sync was written by an older version, and is taken as it is
+   const fc::path synced_path = _dir/"synced";
+   const bool has_synced = fc::exists( synced_path ) && fc::file_size( synced_path ) == sizeof(_synced_through);
+   _synced_fd = open_file( synced_path );
+   if( has_synced )
+      read_at( _synced_fd, (char*)&_synced_through, sizeof(_synced_through), 0 );
+   else
+      write_synced_through( _entry_count > 0 ? _entry_count - 1 : 0 );
+   _last_sync = fc::time_point::now();
+}
+
+void block_database::convert_unchecked_index()
+{ try {
+   const fc::path old_path = _dir/"index";
+   const fc::path new_path = _dir/"entries";
+   // the new index is only renamed into place once it is complete, the old one is removed after that
+   if( !fc::exists( new_path ) )
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out | std::fstream::trunc);
+      ilog( "Adding checksums to the block log index in ${dir}", ("dir",_dir) );
+      const fc::path tmp = _dir/"entries.tmp";
+      std::ifstream in( old_path.generic_string().c_str(), std::ifstream::binary );
+      int fd = open_file( tmp );
+      try
+      {
+         vector<unchecked_index_entry> old_entries( entries_per_chunk );
+         vector<index_entry> entries;
+         uint64_t pos = 0;
+         while( in )
+         {
+            in.read( (char*)old_entries.data(), old_entries.size() * sizeof(unchecked_index_entry) );
+            entries.resize( in.gcount() / sizeof(unchecked_index_entry) );
+            for( size_t i = 0; i < entries.size(); ++i )
+            {
+               entries[i].block_pos  = old_entries[i].block_pos;
+               entries[i].block_size = old_entries[i].block_size;
+               entries[i].block_id   = old_entries[i].block_id;
+            }
+            write_at( fd, (const char*)entries.data(), entries.size() * sizeof(index_entry), pos );
+            pos += entries.size() * sizeof(index_entry);
+         }
+         sync_file( fd );
+      }
+      catch( ... )
+      {
+         close_file( fd );
+         fc::remove( tmp );
+         throw;
+      }
+      close_file( fd );
+      fc::rename( tmp, new_path );
    }
-   else
+   fc::remove( old_path );
+} FC_CAPTURE_AND_RETHROW( (_dir) ) }
+
+bool block_database::is_intact( uint32_t num, const index_entry& e )const
+{
+   if( e.block_size == 0 || block_header::num_from_id( e.block_id ) != num )
+      return false;
+   if( e.checksum == 0 )
+      return true;
+   try
+   {
+      const uint32_t segment = num / _blocks_per_segment;
+      if( segment >= _segments.size() || !_segments[segment] || e.block_pos + e.block_size > _segments[segment]->size )
+         return false;
+      const vector<char> data = read_packed( e, _segments[segment] );
+      return entry_checksum( e, data.data() ) == e.checksum;
+   }
+   catch( const fc::exception& )
+   {
+      return false;
+   }
+}
+
+void block_database::recover_tail()
+{
+   // the entries stored since the last sync may be torn or point at bodies that never reached the disk, the
+   // log is cut at the first of them that is not intact
+   uint32_t end = _entry_count;
+   bool contiguous = _synced_through > 0 && _synced_through < _entry_count &&
+                     mutable_entry( _synced_through ).block_size > 0;
+   for( uint32_t num = _synced_through + 1; num < _entry_count; ++num )
+   {
+      const index_entry& e = mutable_entry( num );
+      // blocks are stored in order, so the only gap is the one before the first block, as after a snapshot import
+      if( e.block_id == block_id_type() && !contiguous )
+         continue;
+      // a popped block has its size cleared, the blocks stored after it are checked on their own
+      if( e.block_id != block_id_type() && e.block_size == 0 )
+         continue;
+      if( !is_intact( num, e ) )
+      {
+         end = num;
+         break;
+      }
+      contiguous = true;
+   }
+   // blocks popped at the end are not part of the chain either, and would only make last() walk over them
+   while( end > 0 && mutable_entry( end - 1 ).block_size == 0 )
+      --end;
+
+   if( end < _entry_count )
+   {
+      wlog( "Dropping ${n} block numbers from the end of the block log that were popped or not completely written",
+            ("n",_entry_count - end) );
+      for( uint32_t num = end; num < _entry_count; ++num )
+         mutable_entry( num ) = index_entry();
+      _entry_count = end;
+      sync();
+   }
+   else if( _synced_through + 1 < _entry_count )
+      sync();
+}
+
+fc::path block_database::segment_path( uint32_t segment, bool sealed )const
+{
+   return _dir / ( std::to_string( segment ) + ( sealed ? ".zblocks" : ".blocks" ) );
+}
+
+void block_database::open_segments()
+{
+   const uint32_t segment_count = _entry_count == 0 ? 0 : ( _entry_count - 1 ) / _blocks_per_segment + 1;
+   _segments.resize( segment_count );
+   for( uint32_t i = 0; i < segment_count; ++i )
+   {
+      const fc::path sealed = segment_path( i, true );
+      const fc::path raw = segment_path( i, false );
+      const fc::path tmp = _dir / ( std::to_string( i ) + ".tmp" );
+      if( fc::exists( tmp ) )
+         fc::remove( tmp );
+
+      if( fc::exists( sealed ) )
+      {
+         // a crash between sealing a segment and removing its raw file leaves both behind
+         if( fc::exists( raw ) )
+            fc::remove( raw );
+         std::shared_ptr<block_segment> s = std::make_shared<block_segment>();
+         s->path   = sealed;
+         s->fd     = open_file( sealed );
+         s->sealed = true;
+         s->frames = read_seek_table( s->fd, fc::file_size( sealed ) );
+         if( !s->frames.empty() )
+            s->size = s->frames.back().raw_offset + s->frames.back().raw_size;
+         _segments[i] = s;
+      }
+      else if( fc::exists( raw ) )
+      {
+         std::shared_ptr<block_segment> s = std::make_shared<block_segment>();
+         s->path = raw;
+         s->fd   = open_file( raw );
+         s->size = fc::file_size( raw );
+         _segments[i] = s;
+      }
+   }
+}
+
+void block_database::convert_legacy_log( const fc::path& dbdir )
+{ try {
+   ilog( "Converting the block log in ${dir} to segments", ("dir",dbdir) );
+   // anything already in the segments directory is the output of an interrupted conversion
+   fc::remove_all( dbdir/"segments" );
+
    {
-     _block_num_to_pos.open( (dbdir/"index").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
-     _blocks.open( (dbdir/"blocks").generic_string().c_str(), std::fstream::binary | std::fstream::in | std::fstream::out );
+      std::ifstream index( (dbdir/"index").generic_string().c_str(), std::ifstream::binary );
+      std::shared_ptr<block_segment> blocks = std::make_shared<block_segment>();
+      blocks->fd = open_file( dbdir/"blocks" );
+
+      // the legacy entries are replayed into a fresh index through append()
+      _dir = dbdir/"segments";
+      fc::create_directories( _dir );
+      open_index();
+
+      unchecked_index_entry e;
+      vector<char> data;
+      for( uint32_t num = 0; index.read( (char*)&e, sizeof(e) ); ++num )
+      {
+         if( e.block_size == 0 )
+            continue;
+         data.resize( e.block_size );
+         read_at( blocks->fd, data.data(), data.size(), e.block_pos );
+         append( num, e.block_id, data.data(), data.size() );
+      }
    }
+   close();
+
+   // the blocks file goes first, it is what marks the log as not yet converted
+   fc::remove( dbdir/"blocks" );
+   fc::remove( dbdir/"index" );
 } FC_CAPTURE_AND_RETHROW( (dbdir) ) }
 
 bool block_database::is_open()const
 {
-  return _blocks.is_open();
+  return _index_file != nullptr;
 }
 
 void block_database::close()
 {
-  _blocks.close();
-  _block_num_to_pos.close();
+   finish_sealing( true );
+   if( is_open() )
+   {
+      try
+      {
+         sync();
+      }
+      catch( const fc::exception& e )
+      {
+         elog( "Unable to sync the block log: ${e}", ("e",e.to_detail_string()) );
+      }
+   }
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   _index_chunks.clear();
+   _index_file.reset();
+   if( _index_fd >= 0 )
+      close_file( _index_fd );
+   _index_fd = -1;
+   if( _synced_fd >= 0 )
+      close_file( _synced_fd );
+   _synced_fd = -1;
+   _segments.clear();
+   _unsynced_segments.clear();
+   _entry_count = 0;
+   _head_num = 0;
+   _synced_through = 0;
+   _unsynced_blocks = 0;
 }
 
 void block_database::flush()
 {
-  _blocks.flush();
-  _block_num_to_pos.flush();
+   // another process, or a restart after a crash of this one, already sees every block stored, this only
+   // protects them from a crash of the operating system
+   if( is_open() )
+      sync();
+}
+
+void block_database::set_sync_policy( uint32_t every_blocks, uint32_t every_ms )
+{
+   _sync_blocks = every_blocks;
+   _sync_interval_ms = every_ms;
+}
+
+void block_database::sync()
+{ try {
+   for( uint32_t segment : _unsynced_segments )
+      if( segment < _segments.size() && _segments[segment] && !_segments[segment]->sealed )
+         sync_file( _segments[segment]->fd );
+   _unsynced_segments.clear();
+#ifdef WIN32
+   for( const auto& chunk : _index_chunks )
+      FlushViewOfFile( chunk->get_address(), 0 );
+#endif
+   // the entries are written through the mapping, syncing the file writes them back as well
+   sync_file( _index_fd );
+   write_synced_through( _entry_count > 0 ? _entry_count - 1 : 0 );
+   _unsynced_blocks = 0;
+   _last_sync = fc::time_point::now();
+} FC_CAPTURE_AND_RETHROW() }
+
+void block_database::write_synced_through( uint32_t block_num )
+{
+   write_at( _synced_fd, (const char*)&block_num, sizeof(block_num), 0 );
+   sync_file( _synced_fd );
+   _synced_through = block_num;
+}
+
+void block_database::unsync_from( uint32_t block_num )
+{
+   if( block_num > _synced_through )
+      return;
+   // blocks are popped and stored again in runs up to the undo history long, moving the mark back past all of
+   // them at once saves syncing it for each one
+   write_synced_through( block_num > _seal_delay + 1 ? block_num - 1 - _seal_delay : 0 );
+}
+
+index_entry& block_database::mutable_entry( uint32_t block_num )
+{
+   const uint32_t chunk = block_num / entries_per_chunk;
+   while( _index_chunks.size() <= chunk )
+   {
+      const uint64_t offset = _index_chunks.size() * chunk_bytes;
+      fc::resize_file( _dir/"entries", offset + chunk_bytes );
+      _index_chunks.emplace_back( new fc::mapped_region( *_index_file, fc::read_write, offset, chunk_bytes ) );
+   }
+   return static_cast<index_entry*>( _index_chunks[chunk]->get_address() )[block_num % entries_per_chunk];
+}
+
+bool block_database::read_entry( uint32_t block_num, index_entry& e, segment_ptr* segment )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( block_num >= _entry_count )
+      return false;
+   e = static_cast<const index_entry*>( _index_chunks[block_num / entries_per_chunk]->get_address() )[block_num % entries_per_chunk];
+   if( segment != nullptr )
+      *segment = _segments[block_num / _blocks_per_segment];
+   return true;
+}
+
+bool block_database::read_last_entry( index_entry& e, segment_ptr* segment )const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   for( uint32_t num = _entry_count; num > 0; --num )
+   {
+      e = static_cast<const index_entry*>( _index_chunks[(num - 1) / entries_per_chunk]->get_address() )[(num - 1) % entries_per_chunk];
+      if( e.block_size > 0 )
+      {
+         if( segment != nullptr )
+            *segment = _segments[(num - 1) / _blocks_per_segment];
+         return true;
+      }
+   }
+   return false;
+}
+
+vector<char> block_database::read_packed( const index_entry& e, const segment_ptr& segment )const
+{
+   FC_ASSERT( segment, "The block log segment holding block ${id} is missing", ("id",e.block_id) );
+   if( !segment->sealed )
+   {
+      vector<char> data( e.block_size );
+      read_at( segment->fd, data.data(), data.size(), e.block_pos );
+      return data;
+   }
+
+   auto f = std::upper_bound( segment->frames.begin(), segment->frames.end(), e.block_pos,
+                              []( uint64_t pos, const segment_frame& f ) { return pos < f.raw_offset; } );
+   FC_ASSERT( f != segment->frames.begin() );
+   --f;
+   FC_ASSERT( e.block_pos + e.block_size <= f->raw_offset + f->raw_size,
+              "Block ${id} is not in the seek table of ${file}", ("id",e.block_id)("file",segment->path) );
+   const vector<char> data = inflate_frame( segment->fd, *f );
+   const auto begin = data.begin() + ( e.block_pos - f->raw_offset );
+   return vector<char>( begin, begin + e.block_size );
+}
+
+signed_block block_database::read_block( const index_entry& e, const segment_ptr& segment )const
+{
+   return fc::raw::unpack<signed_block>( read_packed( e, segment ) );
 }
 
+void block_database::append( uint32_t num, const block_id_type& id, const char* data, size_t size )
+{
+   const uint32_t segment = num / _blocks_per_segment;
+   finish_sealing( _sealed_segment.valid() && _sealing_segment == segment );
+   if( segment >= _segments.size() || !_segments[segment] )
+   {
+      std::shared_ptr<block_segment> s = std::make_shared<block_segment>();
+      s->path = segment_path( segment, false );
+      s->fd   = open_file( s->path );
+      s->size = fc::file_size( s->path );
+      std::lock_guard<std::mutex> lock( _mutex );
+      if( segment >= _segments.size() )
+         _segments.resize( segment + 1 );
+      _segments[segment] = s;
+   }
+   else if( _segments[segment]->sealed )
+   {
+      wlog( "Storing block ${num} into sealed block log segment ${s}", ("num",num)("s",segment) );
+      unseal_segment( segment );
+   }
+   block_segment& s = *_segments[segment];
+   unsync_from( num );
+
+   // the body is written before the entry that points at it is published to readers
+   write_at( s.fd, data, size, s.size );
+
+   index_entry e;
+   e.block_pos  = s.size;
+   e.block_size = size;
+   e.block_id   = id;
+   e.checksum   = entry_checksum( e, data );
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      mutable_entry( num ) = e;
+      s.size += size;
+      _entry_count = std::max( _entry_count, num + 1 );
+   }
+
+   _unsynced_segments.insert( segment );
+   ++_unsynced_blocks;
+   if( ( _sync_blocks > 0 && _unsynced_blocks >= _sync_blocks ) ||
+       ( _sync_interval_ms > 0 && fc::time_point::now() - _last_sync >= fc::milliseconds( _sync_interval_ms ) ) )
+      sync();
+
+   _head_num = num;
+   start_sealing();
+}
+
+bool block_database::start_sealing()
+{
+   if( _sealed_segment.valid() )
+      return false;
+   // a segment is sealed once no block of it can be popped any more
+   uint32_t segment = 0;
+   for( ; segment < _segments.size() && uint64_t(segment + 1) * _blocks_per_segment + _seal_delay <= _head_num; ++segment )
+      if( _segments[segment] && !_segments[segment]->sealed )
+         break;
+   if( segment >= _segments.size() || uint64_t(segment + 1) * _blocks_per_segment + _seal_delay > _head_num )
+      return false;
+
+   // only the bodies the index still points at are kept, bodies of removed blocks between them are harmless
+   vector< std::pair<uint64_t, uint32_t> > bodies;
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      const uint32_t first = segment * _blocks_per_segment;
+      const uint32_t last = std::min<uint64_t>( _entry_count, uint64_t(first) + _blocks_per_segment );
+      for( uint32_t num = first; num < last; ++num )
+      {
+         const index_entry& e = mutable_entry( num );
+         if( e.block_size > 0 )
+            bodies.emplace_back( e.block_pos, e.block_size );
+      }
+   }
+   std::sort( bodies.begin(), bodies.end() );
+
+   if( !_seal_thread )
+      _seal_thread = std::make_shared<fc::thread>( "block_log_seal" );
+   const std::shared_ptr<const block_segment> raw = _segments[segment];
+   const fc::path tmp = _dir / ( std::to_string( segment ) + ".tmp" );
+   const fc::path path = segment_path( segment, true );
+   _sealing_segment = segment;
+   _sealed_segment = _seal_thread->async( [raw,bodies,tmp,path]() { return write_sealed_segment( *raw, bodies, tmp, path ); },
+                                          "seal block log segment" );
+   return true;
+}
+
+void block_database::finish_sealing( bool wait )
+{
+   if( !_sealed_segment.valid() || ( !wait && !_sealed_segment.ready() ) )
+      return;
+   const uint32_t segment = _sealing_segment;
+   std::shared_ptr<block_segment> sealed;
+   try
+   {
+      sealed = _sealed_segment.wait();
+   }
+   catch( const fc::exception& e )
+   {
+      // the raw segment is left as it is, and sealing it is tried again with the next block stored
+      elog( "Unable to seal block log segment ${s}: ${e}", ("s",segment)("e",e.to_detail_string()) );
+   }
+   _sealed_segment = fc::future< std::shared_ptr<block_segment> >();
+   if( !sealed )
+      return;
+
+   const std::shared_ptr<block_segment> raw = _segments[segment];
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _segments[segment] = sealed;
+   }
+   // readers still holding the raw segment keep reading from its open descriptor, and where the file cannot
+   // be removed while it is open, open() removes it the next time around
+   try
+   {
+      fc::remove( raw->path );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to remove ${file}: ${e}", ("file",raw->path)("e",e.to_detail_string()) );
+   }
+}
+
+void block_database::wait_for_sealing()
+{
+   do
+      finish_sealing( true );
+   while( start_sealing() );
+}
+
+void block_database::unseal_segment( uint32_t segment )
+{ try {
+   const std::shared_ptr<block_segment> sealed = _segments[segment];
+   std::shared_ptr<block_segment> raw = std::make_shared<block_segment>();
+   raw->path = segment_path( segment, false );
+   raw->fd   = open_file( raw->path );
+   raw->size = sealed->size;
+
+   // the frames are written back at their old offsets, so the index entries stay valid
+   for( const segment_frame& f : sealed->frames )
+   {
+      const vector<char> data = inflate_frame( sealed->fd, f );
+      write_at( raw->fd, data.data(), data.size(), f.raw_offset );
+   }
+   // the raw file must be complete on disk before the sealed one is removed
+   sync_file( raw->fd );
+
+   {
+      std::lock_guard<std::mutex> lock( _mutex );
+      _segments[segment] = raw;
+   }
+   try
+   {
+      fc::remove( sealed->path );
+   }
+   catch( const fc::exception& e )
+   {
+      wlog( "Unable to remove ${file}: ${e}", ("file",sealed->path)("e",e.to_detail_string()) );
+   }
+} FC_CAPTURE_AND_RETHROW( (segment) ) }
+
 void block_database::store( const block_id_type& _id, const signed_block& b )
 {
    block_id_type id = _id;
@@ -80,34 +831,27 @@ void block_database::store( const block_id_type& _id, const signed_block& b )
       elog( "id argument of block_database::store() was not initialized for block ${id}", ("id", id) );
    }
    auto num = block_header::num_from_id(id);
-   _block_num_to_pos.seekp( sizeof( index_entry ) * num );
-   index_entry e;
-   _blocks.seekp( 0, _blocks.end );
    auto vec = fc::raw::pack( b );
-   e.block_pos  = _blocks.tellp();
-   e.block_size = vec.size();
-   e.block_id   = id;
-   _blocks.write( vec.data(), vec.size() );
-   _block_num_to_pos.write( (char*)&e, sizeof(e) );
+   append( num, id, vec.data(), vec.size() );
+}
+
+void block_database::store_packed( const block_id_type& id, const vector<char>& packed )
+{
+   FC_ASSERT( id != block_id_type() );
+   append( block_header::num_from_id( id ), id, packed.data(), packed.size() );
 }
 
 void block_database::remove( const block_id_type& id )
 { try {
-   index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   auto num = block_header::num_from_id(id);
+   unsync_from( num );
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( num >= _entry_count )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block ${id} not contained in block database", ("id", id));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
+   index_entry& e = mutable_entry( num );
    if( e.block_id == id )
-   {
       e.block_size = 0;
-      _block_num_to_pos.seekp( sizeof(e)*block_header::num_from_id(id) );
-      _block_num_to_pos.write( (char*)&e, sizeof(e) );
-   }
 } FC_CAPTURE_AND_RETHROW( (id) ) }
 
 bool block_database::contains( const block_id_type& id )const
@@ -116,13 +860,8 @@ bool block_database::contains( const block_id_type& id )const
       return false;
 
    index_entry e;
-   auto index_pos = sizeof(e)*block_header::num_from_id(id);
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= index_pos )
+   if( !read_entry( block_header::num_from_id(id), e ) )
       return false;
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    return e.block_id == id && e.block_size > 0;
 }
 
@@ -130,38 +869,70 @@ block_id_type block_database::fetch_block_id( uint32_t block_num )const
 {
    assert( block_num != 0 );
    index_entry e;
-   auto index_pos = sizeof(e)*block_num;
-   _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-   if ( _block_num_to_pos.tellg() <= int64_t(index_pos) )
+   if( !read_entry( block_num, e ) )
       FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", block_num));
 
-   _block_num_to_pos.seekg( index_pos );
-   _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
    FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
    return e.block_id;
 }
 
+vector<block_id_type> block_database::fetch_block_ids( uint32_t first, uint32_t last )const
+{
+   assert( first != 0 );
+   vector<block_id_type> result;
+   if( last < first )
+      return result;
+   result.reserve( last - first + 1 );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( last >= _entry_count )
+      FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", last));
+   uint32_t num = first;
+   while( num <= last )
+   {
+      // the entries of each chunk are contiguous
+      const index_entry* entries = static_cast<const index_entry*>( _index_chunks[num / entries_per_chunk]->get_address() );
+      const uint32_t chunk_last = std::min<uint64_t>( last, (uint64_t(num / entries_per_chunk) + 1) * entries_per_chunk - 1 );
+      for( ; num <= chunk_last; ++num )
+      {
+         const index_entry& e = entries[num % entries_per_chunk];
+         FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
+         result.push_back( e.block_id );
+      }
+   }
+   return result;
+}
+
+vector<block_id_type> block_database::fetch_block_ids( const vector<uint32_t>& block_nums )const
+{
+   vector<block_id_type> result;
+   result.reserve( block_nums.size() );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   for( uint32_t num : block_nums )
+   {
+      assert( num != 0 );
+      if( num >= _entry_count )
+         FC_THROW_EXCEPTION(fc::key_not_found_exception, "Block number ${block_num} not contained in block database", ("block_num", num));
+      const index_entry& e = static_cast<const index_entry*>( _index_chunks[num / entries_per_chunk]->get_address() )[num % entries_per_chunk];
+      FC_ASSERT( e.block_id != block_id_type(), "Empty block_id in block_database (maybe corrupt on disk?)" );
+      result.push_back( e.block_id );
+   }
+   return result;
+}
+
 optional<signed_block> block_database::fetch_optional( const block_id_type& id )const
 {
    try
    {
       index_entry e;
-      auto index_pos = sizeof(e)*block_header::num_from_id(id);
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      segment_ptr segment;
+      if( !read_entry( block_header::num_from_id(id), e, &segment ) )
          return {};
 
-      _block_num_to_pos.seekg( index_pos );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
+      if( e.block_id != id || e.block_size == 0 ) return optional<signed_block>();
 
-      if( e.block_id != id ) return optional<signed_block>();
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      if (e.block_size)
-         _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      auto result = read_block( e, segment );
       FC_ASSERT( result.id() == e.block_id );
       return result;
    }
@@ -174,25 +945,15 @@ optional<signed_block> block_database::fetch_optional( const block_id_type& id )
    return optional<signed_block>();
 }
 
-optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
+optional< vector<char> > block_database::fetch_packed( const block_id_type& id )const
 {
    try
    {
       index_entry e;
-      auto index_pos = sizeof(e)*block_num;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-      if ( _block_num_to_pos.tellg() <= index_pos )
+      segment_ptr segment;
+      if( !read_entry( block_header::num_from_id(id), e, &segment ) || e.block_id != id || e.block_size == 0 )
          return {};
-
-      _block_num_to_pos.seekg( index_pos, _block_num_to_pos.beg );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
-      FC_ASSERT( result.id() == e.block_id );
-      return result;
+      return read_packed( e, segment );
    }
    catch (const fc::exception&)
    {
@@ -200,36 +961,20 @@ optional<signed_block> block_database::fetch_by_number( uint32_t block_num )cons
    catch (const std::exception&)
    {
    }
-   return optional<signed_block>();
+   return optional< vector<char> >();
 }
 
-optional<signed_block> block_database::last()const
+optional<signed_block> block_database::fetch_by_number( uint32_t block_num )const
 {
    try
    {
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<signed_block>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
-         return optional<signed_block>();
+      segment_ptr segment;
+      if( !read_entry( block_num, e, &segment ) || e.block_size == 0 )
+         return {};
 
-      vector<char> data( e.block_size );
-      _blocks.seekg( e.block_pos );
-      _blocks.read( data.data(), e.block_size );
-      auto result = fc::raw::unpack<signed_block>(data);
+      auto result = read_block( e, segment );
+      FC_ASSERT( result.id() == e.block_id );
       return result;
    }
    catch (const fc::exception&)
@@ -241,30 +986,16 @@ optional<signed_block> block_database::last()const
    return optional<signed_block>();
 }
 
-optional<block_id_type> block_database::last_id()const
+optional<signed_block> block_database::last()const
 {
    try
    {
       index_entry e;
-      _block_num_to_pos.seekg( 0, _block_num_to_pos.end );
-
-      if( _block_num_to_pos.tellp() < sizeof(index_entry) )
-         return optional<block_id_type>();
-
-      _block_num_to_pos.seekg( -sizeof(index_entry), _block_num_to_pos.end );
-      _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      uint64_t pos = _block_num_to_pos.tellg();
-      while( e.block_size == 0 && pos > 0 )
-      {
-         pos -= sizeof(index_entry);
-         _block_num_to_pos.seekg( pos );
-         _block_num_to_pos.read( (char*)&e, sizeof(e) );
-      }
-
-      if( e.block_size == 0 )
-         return optional<block_id_type>();
+      segment_ptr segment;
+      if( !read_last_entry( e, &segment ) )
+         return optional<signed_block>();
 
-      return e.block_id;
+      return read_block( e, segment );
    }
    catch (const fc::exception&)
    {
@@ -272,7 +1003,15 @@ optional<block_id_type> block_database::last_id()const
    catch (const std::exception&)
    {
    }
-   return optional<block_id_type>();
+   return optional<signed_block>();
+}
+
+optional<block_id_type> block_database::last_id()const
+{
+   index_entry e;
+   if( !read_last_entry( e ) )
+      return optional<block_id_type>();
+   return e.block_id;
 }
 
 
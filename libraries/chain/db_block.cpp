@@ -31,11 +31,28 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 #include <graphene/chain/exceptions.hpp>
 
+#include <algorithm>
+
 namespace graphene { namespace chain {
 
+struct operation_fee_getter
+{
+   typedef asset result_type;
+   template<typename T>
+   asset operator()( const T& op )const { return op.fee; }
+};
+
+struct operation_fee_payer_getter
+{
+   typedef account_id_type result_type;
+   template<typename T>
+   account_id_type operator()( const T& op )const { return op.fee_payer(); }
+};
+
 bool database::is_known_block( const block_id_type& id )const
 {
-   return _fork_db.is_known_block(id) || _block_id_to_block.contains(id);
+   // a block kept until it links is known as well, so that it is not fetched again
+   return _fork_db.is_known_block(id) || _fork_db.fetch_unlinked_block(id) || _block_id_to_block.contains(id);
 }
 /**
  * Only return true *if* the transaction has not expired or been invalidated. If this
@@ -53,22 +70,153 @@ block_id_type  database::get_block_id_for_num( uint32_t block_num )const
    return _block_id_to_block.fetch_block_id( block_num );
 } FC_CAPTURE_AND_RETHROW( (block_num) ) }
 
+vector<block_id_type> database::get_block_ids_for_nums( uint32_t first, uint32_t last )const
+{ try {
+   return _block_id_to_block.fetch_block_ids( first, last );
+} FC_CAPTURE_AND_RETHROW( (first)(last) ) }
+
+vector<block_id_type> database::get_block_ids_for_nums( const vector<uint32_t>& block_nums )const
+{ try {
+   return _block_id_to_block.fetch_block_ids( block_nums );
+} FC_CAPTURE_AND_RETHROW( (block_nums) ) }
+
 optional<signed_block> database::fetch_block_by_id( const block_id_type& id )const
 {
-   auto b = _fork_db.fetch_block( id );
+   auto b = fetch_shared_block_by_id( id );
    if( !b )
-      return _block_id_to_block.fetch_optional(id);
-   return b->data;
+      return optional<signed_block>();
+   return *b;
 }
 
 optional<signed_block> database::fetch_block_by_number( uint32_t num )const
+{
+   auto b = fetch_shared_block_by_number( num );
+   if( !b )
+      return optional<signed_block>();
+   return *b;
+}
+
+std::shared_ptr<const signed_block> database::fetch_shared_block_by_id( const block_id_type& id )const
+{
+   auto item = _fork_db.fetch_block( id );
+   if( item )
+      return item->block->block_ptr();
+   if( !_block_cache.enabled() )
+   {
+      auto b = _block_id_to_block.fetch_optional( id );
+      if( !b )
+         return std::shared_ptr<const signed_block>();
+      return std::make_shared<const signed_block>( std::move( *b ) );
+   }
+
+   auto b = _block_cache.get( id );
+   if( b )
+      return b;
+   load_block( id, &b );
+   return b;
+}
+
+std::shared_ptr<const signed_block> database::fetch_shared_block_by_number( uint32_t num )const
 {
    auto results = _fork_db.fetch_block_by_number(num);
    if( results.size() == 1 )
-      return results[0]->data;
-   else
-      return _block_id_to_block.fetch_by_number(num);
-   return optional<signed_block>();
+      return results[0]->block->block_ptr();
+   if( !_block_cache.enabled() )
+   {
+      auto b = _block_id_to_block.fetch_by_number( num );
+      if( !b )
+         return std::shared_ptr<const signed_block>();
+      return std::make_shared<const signed_block>( std::move( *b ) );
+   }
+
+   block_id_type id;
+   try
+   {
+      id = _block_id_to_block.fetch_block_id( num );
+   }
+   catch( const fc::exception& )
+   {
+      return std::shared_ptr<const signed_block>();
+   }
+   auto b = _block_cache.get( id );
+   if( b )
+      return b;
+   load_block( id, &b );
+   return b;
+}
+
+std::shared_ptr<const vector<char>> database::fetch_packed_block_by_id( const block_id_type& id )const
+{
+   auto item = _fork_db.fetch_block( id );
+   if( item )
+      return item->block->packed();
+
+   std::shared_ptr<const vector<char>> packed;
+   if( _block_cache.keeps_packed() )
+   {
+      packed = _block_cache.get_packed( id );
+      if( !packed )
+         load_block( id, nullptr, &packed );
+      if( packed )
+         return packed;
+   }
+
+   auto b = fetch_shared_block_by_id( id );
+   if( b )
+      packed = std::make_shared<const vector<char>>( fc::raw::pack( *b ) );
+   return packed;
+}
+
+void database::load_block( const block_id_type& id, std::shared_ptr<const signed_block>* block,
+                           std::shared_ptr<const vector<char>>* packed )const
+{
+   auto data = _block_id_to_block.fetch_packed( id );
+   if( !data )
+      return;
+   try
+   {
+      auto b = std::make_shared<const signed_block>( fc::raw::unpack<signed_block>( *data ) );
+      FC_ASSERT( b->id() == id );
+      auto p = std::make_shared<const vector<char>>( std::move( *data ) );
+      _block_cache.put( id, b, p );
+      if( block != nullptr )
+         *block = b;
+      if( packed != nullptr )
+         *packed = p;
+   }
+   catch( const fc::exception& e )
+   {
+      elog( "Unable to load block ${id}: ${e}", ("id",id)("e",e.to_detail_string()) );
+   }
+}
+
+void database::set_block_cache_size( uint64_t bytes, bool keep_packed )
+{
+   _block_cache.set_capacity( bytes, keep_packed );
+}
+
+block_cache_statistics database::get_block_cache_statistics()const
+{
+   return _block_cache.get_statistics();
+}
+
+optional<transaction_location> database::find_transaction( const transaction_id_type& id )const
+{
+   // the index may point at blocks that were popped since, or at other transactions with a similar id
+   for( const transaction_location& loc : _transaction_id_index.find( id ) )
+   {
+      auto b = fetch_shared_block_by_number( loc.block_num );
+      if( b && loc.trx_in_block < b->transactions.size() && b->transactions[loc.trx_in_block].id() == id )
+         return loc;
+   }
+   return optional<transaction_location>();
+}
+
+void database::store_block( const shared_block_ptr& b )
+{
+   _block_id_to_block.store_packed( b->id(), *b->packed() );
+   if( _transaction_id_index.is_open() )
+      _transaction_id_index.add_block( b->block() );
 }
 
 const signed_transaction& database::get_recent_transaction(const transaction_id_type& trx_id) const
@@ -104,21 +252,33 @@ std::vector<block_id_type> database::get_block_ids_on_fork(block_id_type head_of
  * @return true if we switched forks as a result of this push.
  */
 bool database::push_block(const signed_block& new_block, uint32_t skip)
+{
+   return push_block( std::make_shared<const shared_block>( new_block ), skip );
+}
+
+bool database::push_block(const shared_block_ptr& new_block, uint32_t skip)
 {
    //idump((new_block.block_num())(new_block.id())(new_block.timestamp)(new_block.previous));
    bool result;
    detail::with_skip_flags( *this, skip, [&]()
    {
-      detail::without_pending_transactions( *this, std::move(_pending_tx),
+      detail::without_pending_transactions( *this, _pending_tx.release(),
       [&]()
       {
          result = _push_block(new_block);
+         if( _state_checkpoint_interval && head_block_num() % _state_checkpoint_interval == 0 )
+            write_state_checkpoint();
+         if( read_views_enabled() )
+            publish_read_view( head_block_num() );
+         update_head_state_digest();
+         if( _index_statistics_interval && head_block_num() % _index_statistics_interval == 0 )
+            log_index_statistics();
       });
    });
    return result;
 }
 
-bool database::_push_block(const signed_block& new_block)
+bool database::_push_block(const shared_block_ptr& new_block)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
    if( !(skip&skip_fork_db) )
@@ -128,52 +288,75 @@ bool database::_push_block(const signed_block& new_block)
 
       shared_ptr<fork_item> new_head = _fork_db.push_block(new_block);
       //If the head block from the longest chain does not build off of the current head, we need to switch forks.
-      if( new_head->data.previous != head_block_id() )
+      if( new_head->data().previous != head_block_id() )
       {
          //If the newly pushed block is the same height as head, we get head back in new_head
          //Only switch forks if new_head is actually higher than head
-         if( new_head->data.block_num() > head_block_num() )
+         if( new_head->num > head_block_num() )
          {
-            wlog( "Switching to fork: ${id}", ("id",new_head->data.id()) );
-            auto branches = _fork_db.fetch_branch_from(new_head->data.id(), head_block_id());
+            auto branches = _fork_db.fetch_branch_from(new_head->id, head_block_id());
+            if( branches.first.back()->id == head_block_id() )
+            {
+               // the pushed block linked blocks that arrived before it, which extend the chain past it
+               for( auto ritr = branches.first.rbegin() + 1; ritr != branches.first.rend(); ++ritr )
+               {
+                  try {
+                     undo_database::session session = _undo_db.start_undo_session();
+                     apply_block( (*ritr)->data(), skip );
+                     store_block( (*ritr)->block );
+                     session.commit();
+                  }
+                  catch( const fc::exception& e )
+                  {
+                     // drop the invalid block and every block built on it, then fail only if it is the pushed one
+                     const bool pushed_block_failed = (*ritr)->id == new_block->id();
+                     _fork_db.remove( (*ritr)->id );
+                     _fork_db.set_head( _fork_db.fetch_block( head_block_id() ) );
+                     if( pushed_block_failed )
+                        throw;
+                     wlog( "Dropped blocks that linked to block ${id}: ${e}", ("id",new_block->id())("e",e.to_detail_string()) );
+                     break;
+                  }
+               }
+               return false;
+            }
+
+            wlog( "Switching to fork: ${id}", ("id",new_head->id) );
 
             // pop blocks until we hit the forked block
-            while( head_block_id() != branches.second.back()->data.previous )
+            while( head_block_id() != branches.second.back()->data().previous )
                pop_block();
 
             // push all blocks on the new fork
             for( auto ritr = branches.first.rbegin(); ritr != branches.first.rend(); ++ritr )
             {
-                ilog( "pushing blocks from fork ${n} ${id}", ("n",(*ritr)->data.block_num())("id",(*ritr)->data.id()) );
+                ilog( "pushing blocks from fork ${n} ${id}", ("n",(*ritr)->num)("id",(*ritr)->id) );
                 optional<fc::exception> except;
                 try {
                    undo_database::session session = _undo_db.start_undo_session();
-                   apply_block( (*ritr)->data, skip );
-                   _block_id_to_block.store( (*ritr)->id, (*ritr)->data );
+                   apply_block( (*ritr)->data(), skip );
+                   store_block( (*ritr)->block );
                    session.commit();
                 }
                 catch ( const fc::exception& e ) { except = e; }
                 if( except )
                 {
                    wlog( "exception thrown while switching forks ${e}", ("e",except->to_detail_string() ) );
-                   // remove the rest of branches.first from the fork_db, those blocks are invalid
-                   while( ritr != branches.first.rend() )
-                   {
-                      _fork_db.remove( (*ritr)->data.id() );
-                      ++ritr;
-                   }
+                   // remove the rest of branches.first from the fork_db along with any other block built on
+                   // them, those blocks are invalid
+                   _fork_db.remove( (*ritr)->id );
                    _fork_db.set_head( branches.second.front() );
 
                    // pop all blocks from the bad fork
-                   while( head_block_id() != branches.second.back()->data.previous )
+                   while( head_block_id() != branches.second.back()->data().previous )
                       pop_block();
 
                    // restore all blocks from the good fork
                    for( auto ritr = branches.second.rbegin(); ritr != branches.second.rend(); ++ritr )
                    {
                       auto session = _undo_db.start_undo_session();
-                      apply_block( (*ritr)->data, skip );
-                      _block_id_to_block.store( new_block.id(), (*ritr)->data );
+                      apply_block( (*ritr)->data(), skip );
+                      store_block( (*ritr)->block );
                       session.commit();
                    }
                    throw *except;
@@ -187,17 +370,17 @@ bool database::_push_block(const signed_block& new_block)
 
    try {
       auto session = _undo_db.start_undo_session();
-      apply_block(new_block, skip);
-      _block_id_to_block.store(new_block.id(), new_block);
+      apply_block(new_block->block(), skip);
+      store_block(new_block);
       session.commit();
    } catch ( const fc::exception& e ) {
       elog("Failed to push new block:\n${e}", ("e", e.to_detail_string()));
-      _fork_db.remove(new_block.id());
+      _fork_db.remove(new_block->id());
       throw;
    }
 
    return false;
-} FC_CAPTURE_AND_RETHROW( (new_block) ) }
+} FC_CAPTURE_AND_RETHROW( (new_block->block()) ) }
 
 /**
  * Attempts to push the transaction into the pending queue
@@ -218,7 +401,9 @@ processed_transaction database::push_transaction( const signed_transaction& trx,
    return result;
 } FC_CAPTURE_AND_RETHROW( (trx) ) }
 
-processed_transaction database::_push_transaction( const signed_transaction& trx )
+processed_transaction database::_push_transaction( const signed_transaction& trx,
+                                                   const precomputed_transaction* pre,
+                                                   bool notify )
 {
    // If this is the first transaction pushed after applying a block, start a new undo session.
    // This allows us to quickly rewind to the clean state of the head block, in case a new block arrives.
@@ -230,19 +415,140 @@ processed_transaction database::_push_transaction( const signed_transaction& trx
    // _apply_transaction fails.  If we make it to merge(), we
    // apply the changes.
 
-   auto temp_session = _undo_db.start_undo_session();
-   auto processed_trx = _apply_transaction( trx );
-   _pending_tx.push_back(processed_trx);
+   precomputed_transaction computed;
+   if( !pre )
+   {
+      const bool check_signatures = !(get_node_properties().skip_flags & (skip_transaction_signatures | skip_authority_check));
+      computed.digests = trx.compute_digests( check_signatures ? &get_chain_id() : nullptr );
+      pre = &computed;
+   }
 
-   notify_changed_objects();
+   // a transaction that is already pending or in a block is turned away as such, not for lack of room
+   FC_ASSERT( (get_node_properties().skip_flags & skip_transaction_dupe_check) ||
+              !( _pending_tx.contains( pre->digests.id ) || is_known_transaction( pre->digests.id ) ),
+              "Duplicate transaction ${id}", ("id", pre->digests.id) );
+
+   // turn away what the pending pool has no room for before spending any time applying it
+   const account_id_type fee_payer = trx.operations.empty() ? account_id_type()
+                                                            : trx.operations.front().visit( operation_fee_payer_getter() );
+   const uint64_t fee_per_kb = core_fee_per_kb( trx, pre->digests.pack_size );
+   _pending_tx.check_admission( fee_payer, pre->digests.pack_size, fee_per_kb, head_block_time() );
+
+   if( !_pending_tx.has_room( pre->digests.pack_size ) )
+   {
+      // Nothing is evicted for a transaction that does not apply. The changes of the transactions it evicts are
+      // in the pending state, so that is rebuilt from the ones left before this one is applied on top of it.
+      {
+         auto trial_session = _undo_db.start_undo_session();
+         _apply_transaction( trx, pre );
+      }
+      _pending_tx.evict_for( pre->digests.pack_size, fee_per_kb, head_block_time() );
+      {
+         detail::pending_transactions_restorer restorer( *this, _pending_tx.release() );
+      }
+      if( !_pending_tx_session.valid() )
+         _pending_tx_session = _undo_db.start_undo_session();
+   }
+
+   auto temp_session = _undo_db.start_undo_session();
+   optional< flat_set<account_id_type> > authorities;
+   auto processed_trx = _apply_transaction( trx, pre, &authorities );
+   _pending_tx.insert( processed_trx, pre->digests.id, fee_payer, pre->digests.pack_size, fee_per_kb );
+
+   if( notify )
+      notify_changed_objects();
+   // The authorities of the transactions pushed after this one may depend on what it changed, and this one can
+   // only be checked again without looking at the accounts as long as the changes are tracked.
+   const bool track_authorities = _undo_db.enabled();
+   if( track_authorities )
+      note_authority_changes( _undo_db.head() );
    // The transaction applied successfully. Merge its changes into the pending block session.
    temp_session.merge();
+   if( track_authorities && authorities )
+      _verified_authorities[pre->digests.id] = verified_authority{ trx.signatures, std::move( *authorities ) };
 
    // notify anyone listening to pending transactions
    on_pending_transaction( trx );
    return processed_trx;
 }
 
+fc::time_point_sec database::max_signature_cache_expiration()const
+{
+   return head_block_time() + get_global_properties().parameters.maximum_time_until_expiration;
+}
+
+vector<precomputed_transaction> database::precompute_transactions( const vector<const signed_transaction*>& trxs )
+{
+   signature_recovery_pool::key_getter get_keys;
+   if( !(get_node_properties().skip_flags & (skip_transaction_signatures | skip_authority_check)) )
+   {
+      const fc::time_point_sec max_expiration = max_signature_cache_expiration();
+      get_keys = [this,max_expiration]( const signed_transaction& trx, const digest_type& sig_digest ) {
+         return _signature_cache.get_signature_keys( trx, sig_digest, max_expiration );
+      };
+   }
+   vector<precomputed_transaction> result = _signature_recovery.precompute( get_chain_id(), trxs, get_keys );
+
+   // the authorities of a transaction only depend on its signatures, the accounts it read them from and the
+   // global properties
+   if( get_keys && !_verified_authorities.empty() && !_authority_changes.count( global_property_id_type() ) )
+   {
+      for( size_t i = 0; i < trxs.size(); ++i )
+      {
+         auto itr = _verified_authorities.find( result[i].digests.id );
+         if( itr == _verified_authorities.end() || itr->second.signatures != trxs[i]->signatures )
+            continue;
+         const auto& accounts = itr->second.accounts;
+         if( std::none_of( accounts.begin(), accounts.end(), [&]( account_id_type id ) {
+                return _authority_changes.count( id ) > 0; } ) )
+            result[i].verified_authorities = accounts;
+      }
+   }
+   return result;
+}
+
+void database::clear_verified_authorities()
+{
+   _verified_authorities.clear();
+   _authority_changes.clear();
+}
+
+void database::note_authority_changes( const undo_state& state )
+{
+   auto note = [&]( const object_id_type& id ) {
+      if( id.is<account_id_type>() || id == object_id_type( global_property_id_type() ) )
+         _authority_changes.insert( id );
+   };
+   for( const auto& item : state.old_values )
+      note( item.first );
+   for( const auto& id : state.new_ids )
+      note( id );
+   for( const auto& item : state.removed )
+      note( item.first );
+}
+
+uint64_t database::core_fee_per_kb( const signed_transaction& trx, uint32_t pack_size )const
+{
+   share_type core_fees = 0;
+   for( const auto& op : trx.operations )
+   {
+      const asset fee = op.visit( operation_fee_getter() );
+      if( fee.amount <= 0 )
+         continue;
+      if( fee.asset_id == asset_id_type() )
+         core_fees += fee.amount;
+      else if( const asset_object* fee_asset = find( fee.asset_id ) )
+         core_fees += ( fee * fee_asset->options.core_exchange_rate ).amount;
+      // the transaction cannot pay more than the supply, so the fee per kilobyte cannot overflow
+      if( core_fees >= GRAPHENE_MAX_SHARE_SUPPLY )
+      {
+         core_fees = GRAPHENE_MAX_SHARE_SUPPLY;
+         break;
+      }
+   }
+   return uint64_t( core_fees.value ) * 1024 / std::max( pack_size, 1u );
+}
+
 processed_transaction database::validate_transaction( const signed_transaction& trx )
 {
    auto session = _undo_db.start_undo_session();
@@ -326,37 +632,74 @@ signed_block database::_generate_block(
    _pending_tx_session.reset();
    _pending_tx_session = _undo_db.start_undo_session();
 
+   // the best paying transactions go first, so that they are the ones that fit when the block fills up
+   const auto candidates = _pending_tx.by_priority();
+   vector<const signed_transaction*> pending_trxs;
+   pending_trxs.reserve( candidates.size() );
+   for( const auto* candidate : candidates )
+      pending_trxs.push_back( &candidate->trx );
+   const auto precomputed = precompute_transactions( pending_trxs );
+
    uint64_t postponed_tx_count = 0;
-   // pop pending state (reset to head block state)
-   for( const processed_transaction& tx : _pending_tx )
+   vector< std::pair<size_t, fc::exception> > failed;
+   // @return false if the transaction failed to apply
+   auto include_transaction = [&]( size_t i ) -> bool
    {
-      size_t new_total_size = total_block_size + fc::raw::pack_size( tx );
+      const processed_transaction& tx = candidates[i]->trx;
+      // only the results still need to be packed to size the transaction
+      size_t new_total_size = total_block_size + precomputed[i].digests.pack_size +
+                              fc::raw::pack_size( tx.operation_results );
 
       // postpone transaction if it would make block too big
       if( new_total_size >= maximum_block_size )
       {
          postponed_tx_count++;
-         continue;
+         return true;
       }
 
       try
       {
          auto temp_session = _undo_db.start_undo_session();
-         processed_transaction ptx = _apply_transaction( tx );
+         processed_transaction ptx = _apply_transaction( tx, &precomputed[i] );
          temp_session.merge();
 
          // We have to recompute pack_size(ptx) because it may be different
          // than pack_size(tx) (i.e. if one or more results increased
          // their size)
-         total_block_size += fc::raw::pack_size( ptx );
+         total_block_size += precomputed[i].digests.pack_size + fc::raw::pack_size( ptx.operation_results );
          pending_block.transactions.push_back( ptx );
+         return true;
       }
       catch ( const fc::exception& e )
       {
-         // Do nothing, transaction will not be re-applied
-         wlog( "Transaction was not processed while generating block due to ${e}", ("e", e) );
-         wlog( "The transaction was ${t}", ("t", tx) );
+         failed.emplace_back( i, e );
+         return false;
       }
+   };
+
+   // pop pending state (reset to head block state)
+   for( size_t i = 0; i < candidates.size(); ++i )
+      include_transaction( i );
+
+   // A transaction may depend on one that arrived before it but pays less, so the ones that failed are tried
+   // once more in the order they arrived.  Those that still fail are left to the blocks after this one.
+   if( !failed.empty() && failed.size() < candidates.size() )
+   {
+      vector< std::pair<size_t, fc::exception> > retry;
+      retry.swap( failed );
+      std::sort( retry.begin(), retry.end(), [&]( const std::pair<size_t, fc::exception>& a,
+                                                  const std::pair<size_t, fc::exception>& b ) {
+         return candidates[a.first]->sequence < candidates[b.first]->sequence;
+      });
+      for( const auto& item : retry )
+         include_transaction( item.first );
+   }
+
+   for( const auto& item : failed )
+   {
+      // Do nothing, transaction will not be re-applied
+      wlog( "Transaction was not processed while generating block due to ${e}", ("e", item.second) );
+      wlog( "The transaction was ${t}", ("t", candidates[item.first]->trx) );
    }
    if( postponed_tx_count > 0 )
    {
@@ -398,14 +741,17 @@ void database::pop_block()
 { try {
    _pending_tx_session.reset();
    auto head_id = head_block_id();
-   optional<signed_block> head_block = fetch_block_by_id( head_id );
-   GRAPHENE_ASSERT( head_block.valid(), pop_empty_chain, "there are no blocks to pop" );
+   auto head_block = fetch_shared_block_by_id( head_id );
+   GRAPHENE_ASSERT( head_block, pop_empty_chain, "there are no blocks to pop" );
+   if( !_verified_authorities.empty() )
+      note_authority_changes( _undo_db.head() );
    pop_undo();
    _block_id_to_block.remove( head_id );
+   _block_cache.remove( head_id );
    _fork_db.pop_block();
 
    _popped_tx.insert( _popped_tx.begin(), head_block->transactions.begin(), head_block->transactions.end() );
-
+   update_head_state_digest();
 } FC_CAPTURE_AND_RETHROW() }
 
 void database::clear_pending()
@@ -513,9 +859,52 @@ void database::_apply_block( const signed_block& next_block )
    applied_block( next_block ); //emit
    _applied_ops.clear();
 
+   // the pending transactions checked before this block need their authorities checked again if it changed them
+   if( !_verified_authorities.empty() && _undo_db.enabled() && _undo_db.size() > 0 )
+      note_authority_changes( _undo_db.head() );
+
    notify_changed_objects();
 } FC_CAPTURE_AND_RETHROW( (next_block.block_num()) )  }
 
+void database::write_state_checkpoint()
+{ try {
+   // the block log must contain every block the checkpoint depends on before the checkpoint is written
+   _block_id_to_block.flush();
+   object_database::write_checkpoint();
+   // saving every object would hold up block application, merging the deltas runs in the background instead
+   if( _state_checkpoints_per_merge > 0 && checkpoint_count() % _state_checkpoints_per_merge == 0 )
+      object_database::merge_checkpoints();
+} FC_CAPTURE_AND_RETHROW( (head_block_num()) ) }
+
+void database::update_head_state_digest()
+{
+   _head_state_digest = state_digest_enabled() ? get_state_digest() : fc::sha256();
+}
+
+void database::log_index_statistics()
+{
+   auto stats = get_index_statistics();
+   std::sort( stats.begin(), stats.end(), []( const index_statistics& a, const index_statistics& b ) {
+      return a.approximate_bytes > b.approximate_bytes;
+   });
+
+   const uint32_t blocks = std::max<uint32_t>( 1, head_block_num() - _last_index_statistics_block );
+   for( const auto& s : stats )
+   {
+      if( s.object_count == 0 && s.creates == 0 && s.modifies == 0 && s.removes == 0 ) continue;
+      // indexes are only ever added before open, so the previous sample has the same entries
+      index_statistics prev;
+      for( const auto& p : _last_index_statistics )
+         if( p.space_id == s.space_id && p.type_id == s.type_id ) { prev = p; break; }
+      ilog( "${type}: ${count} objects, ${kb} KB, per block: ${c} creates, ${m} modifies, ${r} removes, ${u} undo bytes",
+            ("type",s.object_type)("count",s.object_count)("kb",s.approximate_bytes / 1024)
+            ("c",(s.creates - prev.creates) / blocks)("m",(s.modifies - prev.modifies) / blocks)
+            ("r",(s.removes - prev.removes) / blocks)("u",(s.undo_bytes - prev.undo_bytes) / blocks) );
+   }
+   _last_index_statistics = std::move( stats );
+   _last_index_statistics_block = head_block_num();
+}
+
 void database::notify_changed_objects()
 { try {
    if( _undo_db.enabled() ) 
@@ -545,24 +934,46 @@ processed_transaction database::apply_transaction(const signed_transaction& trx,
    return result;
 }
 
-processed_transaction database::_apply_transaction(const signed_transaction& trx)
+processed_transaction database::_apply_transaction(const signed_transaction& trx,
+                                                   const precomputed_transaction* pre,
+                                                   optional< flat_set<account_id_type> >* authorities_read)
 { try {
    uint32_t skip = get_node_properties().skip_flags;
+   const bool check_signatures = !(skip & (skip_transaction_signatures | skip_authority_check));
    trx.validate();
    auto& trx_idx = get_mutable_index_type<transaction_index>();
    const chain_id_type& chain_id = get_chain_id();
-   auto trx_id = trx.id();
+   // the signature digest comes from the same serialization as the id, and is only needed to check signatures
+   const transaction_digests digests = pre ? pre->digests : trx.compute_digests( check_signatures ? &chain_id : nullptr );
+   const transaction_id_type& trx_id = digests.id;
    FC_ASSERT( (skip & skip_transaction_dupe_check) ||
               trx_idx.indices().get<by_trx_id>().find(trx_id) == trx_idx.indices().get<by_trx_id>().end() );
    transaction_evaluation_state eval_state(this);
    const chain_parameters& chain_parameters = get_global_properties().parameters;
    eval_state._trx = &trx;
 
-   if( !(skip & (skip_transaction_signatures | skip_authority_check) ) )
+   if( check_signatures && pre && pre->verified_authorities )
    {
-      auto get_active = [&]( account_id_type id ) { return &id(*this).active; };
-      auto get_owner  = [&]( account_id_type id ) { return &id(*this).owner;  };
-      trx.verify_authority( chain_id, get_active, get_owner, get_global_properties().parameters.max_authority_depth );
+      // checked before against accounts that have not changed since
+      if( authorities_read )
+         *authorities_read = pre->verified_authorities;
+   }
+   else if( check_signatures )
+   {
+      flat_set<account_id_type> accounts;
+      auto get_active = [&]( account_id_type id ) { accounts.insert( id ); return &id(*this).active; };
+      auto get_owner  = [&]( account_id_type id ) { accounts.insert( id ); return &id(*this).owner;  };
+      const uint32_t max_authority_depth = get_global_properties().parameters.max_authority_depth;
+      if( pre && pre->signature_keys )
+         trx.verify_authority( *pre->signature_keys, get_active, get_owner, max_authority_depth );
+      else
+      {
+         const digest_type sig_digest = digests.sig_digest ? *digests.sig_digest : trx.sig_digest( chain_id );
+         trx.verify_authority( _signature_cache.get_signature_keys( trx, sig_digest, max_signature_cache_expiration() ),
+                               get_active, get_owner, max_authority_depth );
+      }
+      if( authorities_read )
+         *authorities_read = std::move( accounts );
    }
 
    //Skip all manner of expiration and TaPoS checking if we're on block 1; It's impossible that the transaction is
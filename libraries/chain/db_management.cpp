@@ -25,13 +25,148 @@
 #include <graphene/chain/protocol/fee_schedule.hpp>
 
 #include <fc/io/fstream.hpp>
+#include <fc/io/json.hpp>
+#include <fc/thread/thread.hpp>
 
+#include <condition_variable>
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <mutex>
+#include <thread>
 
 namespace graphene { namespace chain {
 
+namespace {
+   /**
+    * Reads, unpacks and checks the merkle root of the blocks ahead of the one being replayed on worker threads, so
+    * that a replay only waits for the blocks to be applied.  Blocks are handed out in order by next().  The
+    * transaction ids are computed too when they are needed for the transaction id index.
+    */
+   class block_prefetcher
+   {
+      public:
+         struct prefetched_block
+         {
+            optional<signed_block> block;
+            /** set once the merkle root of block was found to match its transactions */
+            bool                   merkle_checked = false;
+            vector<transaction_id_type> trx_ids;
+         };
+
+         block_prefetcher( const block_database& blocks, uint32_t first, uint32_t last, bool check_merkle,
+                           bool compute_trx_ids )
+            :_blocks( blocks ),_check_merkle( check_merkle ),_compute_trx_ids( compute_trx_ids ),
+             _next_to_fetch( first ),_next_to_apply( first ),_last( last ),_slots( window )
+         {
+            const uint32_t worker_count = std::max( 2u, std::thread::hardware_concurrency() ) - 1;
+            for( uint32_t i = 0; i < worker_count; ++i )
+            {
+               _workers.push_back( std::make_shared<fc::thread>( "reindex_" + fc::to_string( uint64_t(i) ) ) );
+               _done.push_back( _workers.back()->async( [this]() { work(); }, "reindex prefetch" ) );
+            }
+         }
+
+         ~block_prefetcher()
+         {
+            stop();
+         }
+
+         /** @return the next block, or an invalid block if it is not in the block log */
+         prefetched_block next()
+         {
+            std::unique_lock<std::mutex> lock( _mutex );
+            slot& s = _slots[_next_to_apply % window];
+            _ready.wait( lock, [&]() { return s.ready; } );
+            prefetched_block result = std::move( s.value );
+            s.ready = false;
+            ++_next_to_apply;
+            _room.notify_all();
+            return result;
+         }
+
+         void stop()
+         {
+            {
+               std::lock_guard<std::mutex> lock( _mutex );
+               _stopped = true;
+            }
+            _room.notify_all();
+            for( auto& f : _done )
+               f.wait();
+            _done.clear();
+            _workers.clear();
+         }
+
+      private:
+         /** number of blocks the workers may get ahead of the block being applied */
+         static const uint32_t window = 256;
+
+         struct slot
+         {
+            bool             ready = false;
+            prefetched_block value;
+         };
+
+         void work()
+         {
+            while( true )
+            {
+               uint32_t num;
+               {
+                  std::unique_lock<std::mutex> lock( _mutex );
+                  _room.wait( lock, [&]() {
+                     return _stopped || _next_to_fetch > _last || _next_to_fetch < _next_to_apply + window;
+                  });
+                  if( _stopped || _next_to_fetch > _last )
+                     return;
+                  num = _next_to_fetch++;
+               }
+
+               prefetched_block b;
+               b.block = _blocks.fetch_by_number( num );
+               try
+               {
+                  if( _check_merkle && b.block.valid() )
+                     b.merkle_checked = b.block->transaction_merkle_root == b.block->calculate_merkle_root();
+               }
+               catch( ... )
+               {
+                  // left for apply_block to report
+               }
+               if( _compute_trx_ids && b.block.valid() )
+               {
+                  b.trx_ids.reserve( b.block->transactions.size() );
+                  for( const auto& trx : b.block->transactions )
+                     b.trx_ids.push_back( trx.id() );
+               }
+
+               std::lock_guard<std::mutex> lock( _mutex );
+               slot& s = _slots[num % window];
+               s.value = std::move( b );
+               s.ready = true;
+               _ready.notify_all();
+            }
+         }
+
+         const block_database&               _blocks;
+         const bool                          _check_merkle;
+         const bool                          _compute_trx_ids;
+         uint32_t                            _next_to_fetch;
+         uint32_t                            _next_to_apply;
+         const uint32_t                      _last;
+         bool                                _stopped = false;
+         /** the block numbered n waits in _slots[n % window] until next() takes it */
+         vector<slot>                        _slots;
+         std::mutex                          _mutex;
+         /** signalled when a block is ready, and when a slot is freed or the workers must stop */
+         std::condition_variable             _ready;
+         std::condition_variable             _room;
+         vector< std::shared_ptr<fc::thread> > _workers;
+         vector< fc::future<void> >          _done;
+   };
+}
+
 database::database()
 {
    initialize_indexes();
@@ -45,8 +180,25 @@ database::~database()
 
 void database::reindex(fc::path data_dir, const genesis_state_type& initial_allocation)
 { try {
+   // the block log of a node started from a snapshot begins at the snapshot's block, so it is replayed from there
+   const fc::path base = snapshot_base_dir( data_dir );
+   if( fc::exists( base / "snapshot.json" ) )
+   {
+      ilog( "reindexing blockchain from the snapshot it was started from" );
+      open_from_snapshot( data_dir, base );
+      return;
+   }
+
    ilog( "reindexing blockchain" );
    wipe(data_dir, false);
+   // the secondary indexes are not needed to apply blocks, so build them once when the replay is done
+   bulk_load_guard bulk_load( *this );
+   if( _transaction_id_index_enabled )
+   {
+      // rebuilt along with the replay below, open() leaves an index that is already open alone
+      _transaction_id_index.open( data_dir / "database" / "transaction_id_index" );
+      _transaction_id_index.clear();
+   }
    open(data_dir, [&initial_allocation]{return initial_allocation;});
 
    auto start = fc::time_point::now();
@@ -54,48 +206,82 @@ void database::reindex(fc::path data_dir, const genesis_state_type& initial_allo
    if( !last_block ) {
       elog( "!no last block" );
       edump((last_block));
+      bulk_load.complete();
       return;
    }
 
    const auto last_block_num = last_block->block_num();
+   // a gap at block 1 would drop every block after it
+   FC_ASSERT( _block_id_to_block.fetch_by_number( 1 ).valid(),
+              "The block log does not start at block 1, import the snapshot it was started from again instead" );
 
    ilog( "Replaying blocks..." );
    _undo_db.disable();
-   for( uint32_t i = 1; i <= last_block_num; ++i )
    {
-      if( i % 2000 == 0 ) std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
-      fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
-      if( !block.valid() )
+      block_prefetcher prefetcher( _block_id_to_block, 1, last_block_num, true, _transaction_id_index.is_open() );
+      for( uint32_t i = 1; i <= last_block_num; ++i )
       {
-         wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
-         uint32_t dropped_count = 0;
-         while( true )
+         if( i % 2000 == 0 ) std::cerr << "   " << double(i*100)/last_block_num << "%   "<<i << " of " <<last_block_num<<"   \n";
+         block_prefetcher::prefetched_block next = prefetcher.next();
+         if( !next.block.valid() )
          {
-            fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
-            // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
-            if( !last_id.valid() )
-               break;
-            // we've caught up to the gap
-            if( block_header::num_from_id( *last_id ) <= i )
-               break;
-            _block_id_to_block.remove( *last_id );
-            dropped_count++;
+            wlog( "Reindexing terminated due to gap:  Block ${i} does not exist!", ("i", i) );
+            prefetcher.stop();
+            uint32_t dropped_count = 0;
+            while( true )
+            {
+               fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+               // this can trigger if we attempt to e.g. read a file that has block #2 but no block #1
+               if( !last_id.valid() )
+                  break;
+               // we've caught up to the gap
+               if( block_header::num_from_id( *last_id ) <= i )
+                  break;
+               _block_id_to_block.remove( *last_id );
+               _block_cache.remove( *last_id );
+               dropped_count++;
+            }
+            wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
+            break;
          }
-         wlog( "Dropped ${n} blocks from after the gap", ("n", dropped_count) );
-         break;
+         apply_block(*next.block, skip_witness_signature |
+                                  skip_transaction_signatures |
+                                  skip_transaction_dupe_check |
+                                  skip_tapos_check |
+                                  skip_witness_schedule_check |
+                                  skip_authority_check |
+                                  ( next.merkle_checked ? skip_merkle_check : 0 ));
+         if( _transaction_id_index.is_open() )
+            _transaction_id_index.add_block( i, next.trx_ids );
       }
-      apply_block(*block, skip_witness_signature |
-                          skip_transaction_signatures |
-                          skip_transaction_dupe_check |
-                          skip_tapos_check |
-                          skip_witness_schedule_check |
-                          skip_authority_check);
    }
    _undo_db.enable();
+   bulk_load.complete();
+   // every object was touched by the replay, so start the checkpoint chain over from a full flush
+   if( checkpoints_enabled() )
+   {
+      _block_id_to_block.flush();
+      object_database::flush();
+   }
+   if( read_views_enabled() )
+      publish_read_view( head_block_num() );
+   update_head_state_digest();
    auto end = fc::time_point::now();
    ilog( "Done reindexing, elapsed time: ${t} sec", ("t",double((end-start).count())/1000000.0 ) );
 } FC_CAPTURE_AND_RETHROW( (data_dir) ) }
 
+void database::set_state_checkpoint_interval( uint32_t block_interval, uint32_t checkpoints_per_merge )
+{
+   _state_checkpoint_interval = block_interval;
+   _state_checkpoints_per_merge = checkpoints_per_merge;
+   enable_checkpoints( block_interval > 0 );
+}
+
+void database::set_block_log_sync_policy( uint32_t every_blocks, uint32_t every_ms )
+{
+   _block_id_to_block.set_sync_policy( every_blocks, every_ms );
+}
+
 void database::wipe(const fc::path& data_dir, bool include_blocks)
 {
    ilog("Wiping database", ("include_blocks", include_blocks));
@@ -111,60 +297,209 @@ void database::open(
 {
    try
    {
+      bulk_load_guard bulk_load( *this );
       object_database::open(data_dir);
 
       _block_id_to_block.open(data_dir / "database" / "block_num_to_block");
+      open_transaction_id_index(data_dir);
 
       if( !find(global_property_id_type()) )
          init_genesis(genesis_loader());
 
-      fc::optional<signed_block> last_block = _block_id_to_block.last();
-      if( last_block.valid() )
+      catch_up_with_block_log();
+      bulk_load.complete();
+      if( read_views_enabled() )
+         publish_read_view( head_block_num() );
+      update_head_state_digest();
+      //idump((head_block_id())(head_block_num()));
+   }
+   FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
+}
+
+void database::catch_up_with_block_log()
+{
+   fc::optional<signed_block> last_block = _block_id_to_block.last();
+   if( last_block.valid() )
+   {
+      idump((last_block->id())(last_block->block_num()));
+      if( last_block->id() != head_block_id() && head_block_num() != 0 )
       {
-         _fork_db.start_block( *last_block );
-         idump((last_block->id())(last_block->block_num()));
-         if( last_block->id() != head_block_id() )
+         // the state was restored from a checkpoint or a snapshot, catch up with the blocks written since then
+         FC_ASSERT( last_block->block_num() > head_block_num() &&
+                    _block_id_to_block.fetch_block_id( head_block_num() ) == head_block_id(),
+                    "last block ID does not match current chain state" );
+
+         ilog( "Replaying blocks ${f} through ${l} written after the last checkpoint",
+               ("f",head_block_num() + 1)("l",last_block->block_num()) );
+         _undo_db.disable();
+         for( uint32_t i = head_block_num() + 1; i <= last_block->block_num(); ++i )
          {
-              FC_ASSERT( head_block_num() == 0, "last block ID does not match current chain state" );
+            fc::optional< signed_block > block = _block_id_to_block.fetch_by_number(i);
+            FC_ASSERT( block.valid(), "Block ${i} is missing from the block log", ("i",i) );
+            apply_block(*block, skip_witness_signature |
+                                skip_transaction_signatures |
+                                skip_transaction_dupe_check |
+                                skip_tapos_check |
+                                skip_witness_schedule_check |
+                                skip_authority_check);
          }
+         _undo_db.enable();
       }
-      //idump((head_block_id())(head_block_num()));
+      _fork_db.start_block( std::make_shared<const shared_block>( std::move( *last_block ) ) );
    }
-   FC_CAPTURE_LOG_AND_RETHROW( (data_dir) )
 }
 
-void database::close(bool rewind)
+void database::open_transaction_id_index( const fc::path& data_dir )
+{ try {
+   if( !_transaction_id_index_enabled || _transaction_id_index.is_open() )
+      return;
+   _transaction_id_index.open( data_dir / "database" / "transaction_id_index" );
+
+   const fc::optional< block_id_type > last_id = _block_id_to_block.last_id();
+   if( !last_id.valid() )
+      return;
+   const uint32_t first = _transaction_id_index.indexed_through() + 1;
+   const uint32_t last = block_header::num_from_id( *last_id );
+   if( first > last )
+      return;
+
+   ilog( "Indexing the transactions of blocks ${f} through ${l}", ("f",first)("l",last) );
+   block_prefetcher prefetcher( _block_id_to_block, first, last, false, true );
+   for( uint32_t i = first; i <= last; ++i )
+   {
+      block_prefetcher::prefetched_block next = prefetcher.next();
+      if( next.block.valid() )
+         _transaction_id_index.add_block( i, next.trx_ids );
+   }
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+fc::sha256 database::full_state_digest()
 {
-   // TODO:  Save pending tx's on close()
+   if( state_digest_enabled() )
+      return get_state_digest();
+   enable_state_digest( true );
+   const fc::sha256 digest = get_state_digest();
+   enable_state_digest( false );
+   return digest;
+}
+
+void database::create_snapshot( const fc::path& dir )
+{ try {
+   FC_ASSERT( !fc::exists( dir ), "Snapshot ${d} already exists", ("d",dir) );
+
+   // only irreversible state is exported, every node starting from the snapshot then agrees on its head block
+   pop_reversible_blocks();
    clear_pending();
+   FC_ASSERT( head_block_num() > 0, "There is no irreversible block to take a snapshot at" );
 
-   // pop all of the blocks that we can given our undo history, this should
-   // throw when there is no more undo history to pop
-   if( rewind )
+   snapshot_manifest manifest;
+   manifest.block_num = head_block_num();
+   manifest.block_id = head_block_id();
+   manifest.chain_id = get_chain_id();
+   manifest.state_digest = full_state_digest();
+   optional<signed_block> head_block = fetch_block_by_id( manifest.block_id );
+   FC_ASSERT( head_block.valid(), "Block ${n} is missing from the block log", ("n",manifest.block_num) );
+   manifest.head_block = std::move( *head_block );
+
+   const fc::path tmp = dir.generic_string() + ".tmp";
+   fc::remove_all( tmp );
+   fc::create_directories( tmp );
+   save_snapshot( tmp / "object_database" );
+   fc::json::save_to_file( manifest, tmp / "snapshot.json" );
+   fc::rename( tmp, dir );
+   ilog( "Saved a snapshot of block ${n} to ${d}", ("n",manifest.block_num)("d",dir) );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void database::open_from_snapshot( const fc::path& data_dir, const fc::path& snapshot_dir )
+{
+   try
    {
-      try
+      const snapshot_manifest manifest = fc::json::from_file( snapshot_dir / "snapshot.json" ).as<snapshot_manifest>();
+      FC_ASSERT( manifest.head_block.id() == manifest.block_id, "The snapshot does not hold its head block" );
+
+      wipe( data_dir, false );
+      bulk_load_guard bulk_load( *this );
+      object_database::open_from_snapshot( data_dir, snapshot_dir / "object_database" );
+      FC_ASSERT( get_chain_id() == manifest.chain_id, "The snapshot is of chain ${c}", ("c",manifest.chain_id) );
+      FC_ASSERT( head_block_id() == manifest.block_id && head_block_num() == manifest.block_num,
+                 "The snapshot state is not at its head block" );
+      FC_ASSERT( full_state_digest() == manifest.state_digest, "The snapshot state does not match its digest" );
+
+      // the state the block log starts from is kept next to it, so that the log can still be replayed later
+      const fc::path base = snapshot_base_dir( data_dir );
+      if( snapshot_dir != base )
       {
-         uint32_t cutoff = get_dynamic_global_properties().last_irreversible_block_num;
+         const fc::path tmp = base.generic_string() + ".tmp";
+         fc::remove_all( tmp );
+         fc::create_directories( tmp );
+         save_snapshot( tmp / "object_database" );
+         fc::json::save_to_file( manifest, tmp / "snapshot.json" );
+         fc::remove_all( base );
+         fc::rename( tmp, base );
+      }
+
+      // the blocks after the snapshot are replayed from the block log, which must continue the snapshot's chain
+      _block_id_to_block.open( data_dir / "database" / "block_num_to_block" );
+      optional<block_id_type> last_id = _block_id_to_block.last_id();
+      if( last_id.valid() && block_header::num_from_id( *last_id ) >= manifest.block_num )
+         FC_ASSERT( _block_id_to_block.contains( manifest.block_id ),
+                    "The block log does not contain block ${id} of the snapshot, it must be removed before importing",
+                    ("id",manifest.block_id) );
+      else
+         _block_id_to_block.store( manifest.block_id, manifest.head_block );
+      open_transaction_id_index( data_dir );
+
+      catch_up_with_block_log();
+      bulk_load.complete();
+      if( read_views_enabled() )
+         publish_read_view( head_block_num() );
+      update_head_state_digest();
+      ilog( "Started from the snapshot of block ${n}, head block is now ${h}",
+            ("n",manifest.block_num)("h",head_block_num()) );
+   }
+   FC_CAPTURE_LOG_AND_RETHROW( (data_dir)(snapshot_dir) )
+}
 
-         while( head_block_num() > cutoff )
+fc::path database::snapshot_base_dir( const fc::path& data_dir )
+{
+   return data_dir / "database" / "snapshot";
+}
+
+void database::pop_reversible_blocks()
+{
+   try
+   {
+      uint32_t cutoff = get_dynamic_global_properties().last_irreversible_block_num;
+
+      while( head_block_num() > cutoff )
+      {
+      //   elog("pop");
+         block_id_type popped_block_id = head_block_id();
+         pop_block();
+         _fork_db.remove(popped_block_id); // doesn't throw on missing
+         try
+         {
+            _block_id_to_block.remove(popped_block_id);
+         }
+         catch (const fc::key_not_found_exception&)
          {
-         //   elog("pop");
-            block_id_type popped_block_id = head_block_id();
-            pop_block();
-            _fork_db.remove(popped_block_id); // doesn't throw on missing
-            try
-            {
-               _block_id_to_block.remove(popped_block_id);
-            }
-            catch (const fc::key_not_found_exception&)
-            {
-            }
          }
       }
-      catch (...)
-      {
-      }
    }
+   catch (...)
+   {
+   }
+}
+
+void database::close(bool rewind)
+{
+   // TODO:  Save pending tx's on close()
+   clear_pending();
+
+   // pop all of the blocks that we can given our undo history, this should
+   // throw when there is no more undo history to pop
+   if( rewind )
+      pop_reversible_blocks();
 
    // Since pop_block() will move tx's in the popped blocks into pending,
    // we have to clear_pending() after we're done popping to get a clean
@@ -176,6 +511,8 @@ void database::close(bool rewind)
 
    if( _block_id_to_block.is_open() )
       _block_id_to_block.close();
+   _block_cache.clear();
+   _transaction_id_index.close();
 
    _fork_db.reset();
 }
@@ -159,6 +159,9 @@ void database::clear_expired_transactions()
    const auto& dedupe_index = transaction_idx.indices().get<by_expiration>();
    while( (!dedupe_index.empty()) && (head_block_time() > dedupe_index.rbegin()->trx.expiration) )
       transaction_idx.remove(*dedupe_index.rbegin());
+
+   // the keys of expired transactions will not be checked again
+   _signature_cache.remove_expired( head_block_time() );
 }
 
 void database::clear_expired_proposals()
@@ -31,6 +31,8 @@ void fork_database::reset()
 {
    _head.reset();
    _index.clear();
+   _unlinked_index.clear();
+   _unlinked_bytes = 0;
 }
 
 void fork_database::pop_block()
@@ -38,7 +40,7 @@ void fork_database::pop_block()
    if( _head ) _head = _head->prev.lock();
 }
 
-void     fork_database::start_block(signed_block b)
+void     fork_database::start_block(shared_block_ptr b)
 {
    auto item = std::make_shared<fork_item>(std::move(b));
    _index.insert(item);
@@ -48,8 +50,10 @@ void     fork_database::start_block(signed_block b)
 /**
  * Pushes the block into the fork database and caches it if it doesn't link
  *
+ * The unlinkable_block_exception is still thrown for a block that is cached, so that the missing blocks are
+ * fetched.
  */
-shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
+shared_ptr<fork_item>  fork_database::push_block(const shared_block_ptr& b)
 {
    auto item = std::make_shared<fork_item>(b);
    try {
@@ -57,14 +61,46 @@ shared_ptr<fork_item>  fork_database::push_block(const signed_block& b)
    }
    catch ( const unlinkable_block_exception& e )
    {
-      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b.id())("num",b.block_num()) );
-      wlog( "Head: ${num}, ${id}", ("num",_head->data.block_num())("id",_head->data.id()) );
+      wlog( "Pushing block to fork database that failed to link: ${id}, ${num}", ("id",b->id())("num",b->block_num()) );
+      wlog( "Head: ${num}, ${id}", ("num",_head->num)("id",_head->id) );
+      _push_unlinked( item );
       throw;
-      _unlinked_index.insert( item );
    }
    return _head;
 }
 
+void fork_database::_push_unlinked( const item_ptr& item )
+{
+   // a block that far ahead would be dropped before the blocks in between arrived
+   if( item->num > _head->num + MAX_BLOCK_REORDERING )
+      return;
+   if( !_unlinked_index.insert( item ).second )
+      return;
+   _unlinked_bytes += item->block->packed()->size();
+   _trim_unlinked();
+}
+
+void fork_database::_trim_unlinked()
+{
+   auto& num_idx = _unlinked_index.get<block_num>();
+   while( _unlinked_index.size() > _max_unlinked_blocks || _unlinked_bytes > _max_unlinked_bytes )
+   {
+      auto last = std::prev( num_idx.end() );
+      _unlinked_bytes -= (*last)->block->packed()->size();
+      num_idx.erase( last );
+   }
+}
+
+void fork_database::_prune_unlinked( uint32_t min_num )
+{
+   auto& num_idx = _unlinked_index.get<block_num>();
+   while( num_idx.size() && (*num_idx.begin())->num < min_num )
+   {
+      _unlinked_bytes -= (*num_idx.begin())->block->packed()->size();
+      num_idx.erase( num_idx.begin() );
+   }
+}
+
 void  fork_database::_push_block(const item_ptr& item)
 {
    if( _head ) // make sure the block is within the range that we are caching
@@ -94,9 +130,9 @@ void  fork_database::_push_block(const item_ptr& item)
       while( num_idx.size() && (*num_idx.begin())->num < min_num )
          num_idx.erase( num_idx.begin() );
       
-      _unlinked_index.get<block_num>().erase(_head->num - _max_size);
+      _prune_unlinked( min_num );
    }
-   //_push_next( item );
+   _push_next( item );
 }
 
 /**
@@ -113,8 +149,17 @@ void fork_database::_push_next( const item_ptr& new_item )
     while( itr != prev_idx.end() )
     {
        auto tmp = *itr;
+       _unlinked_bytes -= tmp->block->packed()->size();
        prev_idx.erase( itr );
-       _push_block( tmp );
+       try
+       {
+          _push_block( tmp );
+       }
+       catch( const fc::exception& e )
+       {
+          // only the block that was pushed decides whether push_block() fails
+          wlog( "Dropping block ${id} that could not be linked: ${e}", ("id",tmp->id)("e",e.to_detail_string()) );
+       }
 
        itr = prev_idx.find( new_item->id );
     }
@@ -137,29 +182,21 @@ void fork_database::set_max_size( uint32_t s )
          itr = by_num_idx.begin();
       }
    }
-   { /// unlinked_index
-      auto& by_num_idx = _unlinked_index.get<block_num>();
-      auto itr = by_num_idx.begin();
-      while( itr != by_num_idx.end() )
-      {
-         if( (*itr)->num < std::max(int64_t(0),int64_t(_head->num) - _max_size) )
-            by_num_idx.erase(itr);
-         else
-            break;
-         itr = by_num_idx.begin();
-      }
-   }
+   /// unlinked_index
+   _prune_unlinked( uint32_t( std::max(int64_t(0),int64_t(_head->num) - _max_size) ) );
+}
+
+void fork_database::set_max_unlinked( uint32_t blocks, uint64_t bytes )
+{
+   _max_unlinked_blocks = blocks;
+   _max_unlinked_bytes = bytes;
+   _trim_unlinked();
 }
 
 bool fork_database::is_known_block(const block_id_type& id)const
 {
    auto& index = _index.get<block_id>();
-   auto itr = index.find(id);
-   if( itr != index.end() )
-      return true;
-   auto& unlinked_index = _unlinked_index.get<block_id>();
-   auto unlinked_itr = unlinked_index.find(id);
-   return unlinked_itr != unlinked_index.end();
+   return index.find(id) != index.end();
 }
 
 item_ptr fork_database::fetch_block(const block_id_type& id)const
@@ -168,10 +205,15 @@ item_ptr fork_database::fetch_block(const block_id_type& id)const
    auto itr = index.find(id);
    if( itr != index.end() )
       return *itr;
+   return item_ptr();
+}
+
+item_ptr fork_database::fetch_unlinked_block(const block_id_type& id)const
+{
    auto& unlinked_index = _unlinked_index.get<block_id>();
-   auto unlinked_itr = unlinked_index.find(id);
-   if( unlinked_itr != unlinked_index.end() )
-      return *unlinked_itr;
+   auto itr = unlinked_index.find(id);
+   if( itr != unlinked_index.end() )
+      return *itr;
    return item_ptr();
 }
 
@@ -205,19 +247,19 @@ pair<fork_database::branch_type,fork_database::branch_type>
    auto second_branch = *second_branch_itr;
 
 
-   while( first_branch->data.block_num() > second_branch->data.block_num() )
+   while( first_branch->data().block_num() > second_branch->data().block_num() )
    {
       result.first.push_back(first_branch);
       first_branch = first_branch->prev.lock();
       FC_ASSERT(first_branch);
    }
-   while( second_branch->data.block_num() > first_branch->data.block_num() )
+   while( second_branch->data().block_num() > first_branch->data().block_num() )
    {
       result.second.push_back( second_branch );
       second_branch = second_branch->prev.lock();
       FC_ASSERT(second_branch);
    }
-   while( first_branch->data.previous != second_branch->data.previous )
+   while( first_branch->data().previous != second_branch->data().previous )
    {
       result.first.push_back(first_branch);
       result.second.push_back(second_branch);
@@ -241,7 +283,27 @@ void fork_database::set_head(shared_ptr<fork_item> h)
 
 void fork_database::remove(block_id_type id)
 {
-   _index.get<block_id>().erase(id);
+   // the blocks built on a removed block can never be applied either, whether they were linked yet or not
+   vector<block_id_type> ids( 1, id );
+   while( !ids.empty() )
+   {
+      const block_id_type next = ids.back();
+      ids.pop_back();
+      for( fork_multi_index_type* index : { &_index, &_unlinked_index } )
+      {
+         auto children = index->get<by_previous>().equal_range( next );
+         for( auto itr = children.first; itr != children.second; ++itr )
+            ids.push_back( (*itr)->id );
+      }
+      _index.get<block_id>().erase( next );
+      auto& unlinked_index = _unlinked_index.get<block_id>();
+      auto itr = unlinked_index.find( next );
+      if( itr != unlinked_index.end() )
+      {
+         _unlinked_bytes -= (*itr)->block->packed()->size();
+         unlinked_index.erase( itr );
+      }
+   }
 }
 
 } } // graphene::chain
@@ -250,6 +250,9 @@ namespace graphene { namespace chain {
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual void clear() override;
+         /** collects the memberships of every account and builds each map from them in sorted order */
+         virtual void rebuild( const graphene::db::index& accounts ) override;
 
 
          /** given an account or key, map it to the set of accounts that reference it in an active or owner authority */
@@ -281,6 +284,7 @@ namespace graphene { namespace chain {
          virtual void object_removed( const object& obj ) override;
          virtual void about_to_modify( const object& before ) override;
          virtual void object_modified( const object& after  ) override;
+         virtual void clear() override { referred_by.clear(); }
 
          /** maps the referrer to the set of accounts that they have referred */
          map< account_id_type, set<account_id_type> > referred_by;
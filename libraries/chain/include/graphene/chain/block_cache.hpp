@@ -0,0 +1,106 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+#include <mutex>
+
+namespace graphene { namespace chain {
+
+   struct block_cache_statistics
+   {
+      uint64_t capacity = 0;
+      uint64_t bytes = 0;
+      uint32_t block_count = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+   };
+
+   /**
+    *  @brief keeps recently read blocks decoded in memory
+    *
+    *  Blocks are immutable once stored, so every reader of a cached block shares the same object instead of
+    *  reading and unpacking it again.  The cache is bounded by the packed size of the blocks it holds (twice
+    *  that when their packed bytes are kept as well) and evicts the least recently used block first.  All
+    *  methods may be called from any thread.
+    */
+   class block_cache
+   {
+      public:
+         typedef std::shared_ptr<const signed_block>   block_ptr;
+         typedef std::shared_ptr<const vector<char>>   packed_ptr;
+
+         /** a capacity of 0 disables the cache, packed bytes are only kept when keep_packed is set */
+         void                     set_capacity( uint64_t bytes, bool keep_packed );
+         bool                     enabled()const;
+         bool                     keeps_packed()const;
+
+         /** @return the cached block, or null after counting a miss */
+         block_ptr                get( const block_id_type& id );
+         /** @return the packed bytes of a cached block, or null if they are not kept */
+         packed_ptr               get_packed( const block_id_type& id );
+         void                     put( const block_id_type& id, const block_ptr& block, const packed_ptr& packed );
+         void                     remove( const block_id_type& id );
+         void                     clear();
+
+         block_cache_statistics   get_statistics()const;
+
+      private:
+         struct entry
+         {
+            block_id_type  id;
+            block_ptr      block;
+            packed_ptr     packed;
+            uint64_t       bytes;
+         };
+         struct by_id;
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::sequenced<>,
+               boost::multi_index::hashed_unique< boost::multi_index::tag<by_id>,
+                  boost::multi_index::member<entry, block_id_type, &entry::id>, std::hash<fc::ripemd160> >
+            >
+         > entry_index_type;
+
+         /** drops the least recently used blocks until the cache fits its capacity */
+         void                     evict();
+
+         uint64_t                 _capacity = 0;
+         bool                     _keep_packed = false;
+         uint64_t                 _bytes = 0;
+         uint64_t                 _hits = 0;
+         uint64_t                 _misses = 0;
+         uint64_t                 _evictions = 0;
+         /** most recently used first */
+         entry_index_type         _entries;
+         mutable std::mutex       _mutex;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::block_cache_statistics, (capacity)(bytes)(block_count)(hits)(misses)(evictions) )
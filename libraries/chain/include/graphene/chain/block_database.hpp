@@ -20,28 +20,147 @@
  */
 #pragma once
 #include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <graphene/chain/config.hpp>
 #include <graphene/chain/protocol/block.hpp>
 
+#include <fc/thread/future.hpp>
+
+namespace fc { class file_mapping; class mapped_region; class thread; }
+
 namespace graphene { namespace chain {
+   struct index_entry;
+   struct block_segment;
+
+   /**
+    *  @brief stores blocks by number in an append only log
+    *
+    *  The log lives in the "segments" directory.  Its "entries" file holds one fixed size entry per block number
+    *  and is memory mapped.  Block bodies are split into segments of blocks_per_segment block numbers each: the
+    *  segment that is still being written is a plain "<n>.blocks" file, and once the chain is seal_delay blocks
+    *  past its end it is compressed, on a thread of its own so that storing blocks never waits for it, into an
+    *  immutable "<n>.zblocks" file made of independently compressed frames and a seek table, so reading one
+    *  block only inflates the frame holding it.
+    *
+    *  Each entry has a checksum of itself and its block.  The log is synced to disk according to the sync policy
+    *  and the "synced" file records the last block number synced, so after a crash open() only checks the
+    *  entries past it and cuts the log at the first one that was not completely written.
+    *
+    *  All const methods may be called from any thread, concurrently with each other and with store() and
+    *  remove(), which must be called from one thread at a time.
+    */
    class block_database 
    {
       public:
+         explicit block_database( uint32_t blocks_per_segment = 100000,
+                                  uint32_t seal_delay = GRAPHENE_MAX_UNDO_HISTORY );
+         ~block_database();
+
          void open( const fc::path& dbdir );
          bool is_open()const;
+         /** waits until every block stored is on disk */
          void flush();
          void close();
+         /**
+          * syncs the log once every_blocks blocks were stored since the last sync, or when a block is stored
+          * every_ms milliseconds or more after it, 0 disables either
+          */
+         void set_sync_policy( uint32_t every_blocks, uint32_t every_ms );
+         /** waits until every segment that no block can be popped from any more is sealed */
+         void wait_for_sealing();
 
          void store( const block_id_type& id, const signed_block& b );
+         /** stores a block that is already packed */
+         void store_packed( const block_id_type& id, const vector<char>& packed );
          void remove( const block_id_type& id );
 
          bool                   contains( const block_id_type& id )const;
          block_id_type          fetch_block_id( uint32_t block_num )const;
+         /** @return the ids of blocks first through last, read from the index at once */
+         vector<block_id_type>  fetch_block_ids( uint32_t first, uint32_t last )const;
+         /** @return the ids of the given blocks, read from the index at once */
+         vector<block_id_type>  fetch_block_ids( const vector<uint32_t>& block_nums )const;
          optional<signed_block> fetch_optional( const block_id_type& id )const;
          optional<signed_block> fetch_by_number( uint32_t block_num )const;
+         /** @return the block as stored, without unpacking it */
+         optional< vector<char> > fetch_packed( const block_id_type& id )const;
          optional<signed_block> last()const;
          optional<block_id_type> last_id()const;
       private:
-         mutable std::fstream _blocks;
-         mutable std::fstream _block_num_to_pos;
+         typedef std::shared_ptr<const block_segment> segment_ptr;
+
+         /**
+          * copies the entry for block_num and the segment holding its body, returns false if the index does not
+          * reach that far
+          */
+         bool                   read_entry( uint32_t block_num, index_entry& e, segment_ptr* segment = nullptr )const;
+         /** @return the entry of the highest numbered block that has not been removed */
+         bool                   read_last_entry( index_entry& e, segment_ptr* segment = nullptr )const;
+         vector<char>           read_packed( const index_entry& e, const segment_ptr& segment )const;
+         signed_block           read_block( const index_entry& e, const segment_ptr& segment )const;
+         /** maps the part of the index file holding block_num, growing the file if needed */
+         index_entry&           mutable_entry( uint32_t block_num );
+
+         fc::path               segment_path( uint32_t segment, bool sealed )const;
+         void                   open_index();
+         void                   open_segments();
+         /** rewrites the index of older versions, which had no checksums, into the "entries" file */
+         void                   convert_unchecked_index();
+         /** @return whether the entry for block_num and the body it points at are as they were stored */
+         bool                   is_intact( uint32_t block_num, const index_entry& e )const;
+         /** drops the entries at the end of the log that are not intact, or whose blocks were popped */
+         void                   recover_tail();
+         void                   sync();
+         void                   write_synced_through( uint32_t block_num );
+         /** moves the last block number synced before block_num, before its entry is changed */
+         void                   unsync_from( uint32_t block_num );
+         /** appends a packed block to the raw segment holding block_num and publishes its entry */
+         void                   append( uint32_t block_num, const block_id_type& id, const char* data, size_t size );
+         /**
+          * starts compressing the oldest raw segment that no block can be popped from any more in the background,
+          * unless one is being compressed already, returns whether it did
+          */
+         bool                   start_sealing();
+         /** replaces the raw segment by the one compressed in the background once it is done, or waits for it */
+         void                   finish_sealing( bool wait );
+         /** inflates a sealed segment back into a raw one so that blocks can be stored into it again */
+         void                   unseal_segment( uint32_t segment );
+         /** converts the single "blocks" file written by older versions into segments */
+         void                   convert_legacy_log( const fc::path& dbdir );
+
+         const uint32_t                                  _blocks_per_segment;
+         const uint32_t                                  _seal_delay;
+         fc::path                                        _dir;
+         std::unique_ptr<fc::file_mapping>               _index_file;
+         vector< std::unique_ptr<fc::mapped_region> >    _index_chunks;
+         /** indexed by segment number, null for segments that hold no blocks */
+         vector< std::shared_ptr<block_segment> >        _segments;
+         /** one past the highest block number ever stored */
+         uint32_t                                        _entry_count = 0;
+         /** the number of the block stored last */
+         uint32_t                                        _head_num = 0;
+
+         std::shared_ptr<fc::thread>                     _seal_thread;
+         /** the segment being compressed on _seal_thread, and the sealed segment it yields */
+         uint32_t                                        _sealing_segment = 0;
+         fc::future< std::shared_ptr<block_segment> >    _sealed_segment;
+
+         /** a descriptor of the index file, to sync the mapped entries with */
+         int                                             _index_fd = -1;
+         int                                             _synced_fd = -1;
+         uint32_t                                        _synced_through = 0;
+         uint32_t                                        _sync_blocks = 0;
+         uint32_t                                        _sync_interval_ms = 1000;
+         uint32_t                                        _unsynced_blocks = 0;
+         fc::time_point                                  _last_sync;
+         /** raw segments written since the last sync */
+         std::set<uint32_t>                              _unsynced_segments;
+         /**
+          * guards the index entries, the chunk table and the segment table, but not the reads of block bodies,
+          * which hold on to the segment they read from
+          */
+         mutable std::mutex                              _mutex;
    };
 } }
@@ -26,6 +26,11 @@
 #include <graphene/chain/asset_object.hpp>
 #include <graphene/chain/fork_database.hpp>
 #include <graphene/chain/block_database.hpp>
+#include <graphene/chain/block_cache.hpp>
+#include <graphene/chain/signature_cache.hpp>
+#include <graphene/chain/signature_recovery.hpp>
+#include <graphene/chain/transaction_id_index.hpp>
+#include <graphene/chain/transaction_pool.hpp>
 #include <graphene/chain/genesis_state.hpp>
 
 #include <graphene/db/object_database.hpp>
@@ -38,12 +43,26 @@
 #include <fc/log/logger.hpp>
 
 #include <map>
+#include <unordered_map>
 
 namespace graphene { namespace chain {
    using graphene::db::abstract_object;
    using graphene::db::object;
 
    struct budget_record;
+   namespace detail { struct pending_transactions_restorer; }
+
+   /** describes the state saved by database::create_snapshot */
+   struct snapshot_manifest
+   {
+      uint32_t       block_num = 0;
+      block_id_type  block_id;
+      chain_id_type  chain_id;
+      /** the value database::get_state_digest has for the saved state */
+      fc::sha256     state_digest;
+      /** the block the state is at, the first block of the block log of a node started from the snapshot */
+      signed_block   head_block;
+   };
 
    /**
     *   @class database
@@ -93,6 +112,9 @@ namespace graphene { namespace chain {
           *
           * This method may be called after or instead of @ref database::open, and will rebuild the object graph by
           * replaying blockchain history. When this method exits successfully, the database will be open.
+          *
+          * A database started from a snapshot is rebuilt from the copy of the snapshot that @ref open_from_snapshot
+          * kept, since its block log starts at the snapshot's block.
           */
          void reindex(fc::path data_dir, const genesis_state_type& initial_allocation = genesis_state_type());
 
@@ -105,6 +127,95 @@ namespace graphene { namespace chain {
          void wipe(const fc::path& data_dir, bool include_blocks);
          void close(bool rewind = true);
 
+         /**
+          * @brief Save the state at the last irreversible block to a new directory
+          *
+          * The reversible blocks are popped first, like @ref close does.  The snapshot holds every object index,
+          * the irreversible block and a snapshot_manifest identifying them.
+          */
+         void create_snapshot( const fc::path& dir );
+
+         /**
+          * @brief Open a database with the state saved by @ref create_snapshot
+          *
+          * The object database in data_dir is replaced by the snapshot after checking its chain ID and state
+          * digest.  The block log in data_dir is kept: if it already continues past the snapshot's block, which
+          * it must then contain, the blocks after it are replayed; otherwise the snapshot's block is stored in it
+          * and the rest of the chain is synced from the network.  A copy of the snapshot is kept next to the block
+          * log, which is removed along with it, for @ref reindex to start from.
+          */
+         void open_from_snapshot( const fc::path& data_dir, const fc::path& snapshot_dir );
+
+         /**
+          * @brief Periodically save the objects changed by recent blocks so that an unclean shutdown does not
+          * require a full reindex.
+          *
+          * Every @ref block_interval blocks the changed objects are written to a delta checkpoint, and every
+          * @ref checkpoints_per_merge checkpoints the deltas are merged into one file on a background thread.
+          * The whole object database is only saved by @ref close.  On the next @ref open the deltas are applied
+          * and the blocks after the last checkpoint are replayed from the block log.  Must be called before
+          * @ref open.  A block_interval of 0 disables checkpoints, a checkpoints_per_merge of 0 never merges them.
+          */
+         void set_state_checkpoint_interval( uint32_t block_interval, uint32_t checkpoints_per_merge );
+
+         /**
+          * @brief Sync the block log to disk after every @ref every_blocks blocks, or when a block is stored
+          * @ref every_ms milliseconds or more after the last sync.  0 disables either.
+          *
+          * Only the blocks stored since the last sync are checked when the block log is opened after a crash.
+          */
+         void set_block_log_sync_policy( uint32_t every_blocks, uint32_t every_ms );
+
+         /**
+          * @brief Log the size of every index and its average activity per block every @ref block_interval blocks.
+          * A block_interval of 0 disables the log.
+          */
+         void set_index_statistics_interval( uint32_t block_interval ) { _index_statistics_interval = block_interval; }
+
+         /**
+          * @brief Keep up to @ref bytes of recently read blocks decoded in memory, and also their packed bytes when
+          * @ref keep_packed is set.  A size of 0 disables the cache.
+          */
+         void set_block_cache_size( uint64_t bytes, bool keep_packed );
+         block_cache_statistics get_block_cache_statistics()const;
+
+         /**
+          * @brief Maintain an index from the id of every transaction in the block log to its block, for
+          * @ref find_transaction.  Must be called before @ref open, which indexes any blocks that are not yet.
+          */
+         void enable_transaction_id_index( bool enable ) { _transaction_id_index_enabled = enable; }
+
+         /**
+          * @brief Compute the digests and recover the signing keys of the transactions in a generated block, and
+          * of the pending transactions checked again after a block is pushed, on @ref thread_count threads before
+          * they are applied.  0 does it on the calling thread.
+          */
+         void set_signature_recovery_threads( uint32_t thread_count ) { _signature_recovery.set_thread_count( thread_count ); }
+
+         /**
+          * @brief Remember the keys recovered from up to @ref key_count signatures, so that a pending transaction
+          * checked again has none of its keys recovered twice.  0 disables the cache.
+          */
+         void set_signature_cache_size( uint32_t key_count ) { _signature_cache.set_capacity( key_count ); }
+         signature_cache_statistics get_signature_cache_statistics()const { return _signature_cache.get_statistics(); }
+
+         /**
+          * @brief Keep at most @ref max_bytes of pending transactions, and at most @ref max_per_account of them
+          * paid by any one account.  When the pool is full, a transaction only gets in by paying more per byte
+          * than the ones it evicts.  0 leaves either unlimited.
+          */
+         void set_pending_transaction_limits( uint64_t max_bytes, uint32_t max_per_account )
+         { _pending_tx.set_limits( max_bytes, max_per_account ); }
+         transaction_pool_statistics get_pending_transaction_statistics()const { return _pending_tx.get_statistics(); }
+
+         /**
+          * @brief Digest of every consensus object after the head block was applied
+          *
+          * Only maintained while @ref state_digest_enabled; the indexes registered by plugins are not included,
+          * so two nodes at the same head block have the same digest exactly when their chain state agrees.
+          */
+         const fc::sha256& head_state_digest()const { return _head_state_digest; }
+
          //////////////////// db_block.cpp ////////////////////
 
          /**
@@ -114,9 +225,19 @@ namespace graphene { namespace chain {
          bool                       is_known_block( const block_id_type& id )const;
          bool                       is_known_transaction( const transaction_id_type& id )const;
          block_id_type              get_block_id_for_num( uint32_t block_num )const;
+         /** @return the ids of blocks first through last, which must all be in the block log */
+         vector<block_id_type>      get_block_ids_for_nums( uint32_t first, uint32_t last )const;
+         vector<block_id_type>      get_block_ids_for_nums( const vector<uint32_t>& block_nums )const;
          optional<signed_block>     fetch_block_by_id( const block_id_type& id )const;
          optional<signed_block>     fetch_block_by_number( uint32_t num )const;
+         /** like fetch_block_by_id(), but shares the block with the block cache instead of copying it */
+         std::shared_ptr<const signed_block> fetch_shared_block_by_id( const block_id_type& id )const;
+         std::shared_ptr<const signed_block> fetch_shared_block_by_number( uint32_t num )const;
+         /** @return the packed block, served without unpacking and packing it again when the block cache keeps it */
+         std::shared_ptr<const vector<char>> fetch_packed_block_by_id( const block_id_type& id )const;
          const signed_transaction&  get_recent_transaction( const transaction_id_type& trx_id )const;
+         /** @return where the transaction is in the chain, only known with the transaction id index enabled */
+         optional<transaction_location> find_transaction( const transaction_id_type& id )const;
          std::vector<block_id_type> get_block_ids_on_fork(block_id_type head_of_fork) const;
 
          /**
@@ -130,9 +251,26 @@ namespace graphene { namespace chain {
          bool before_last_checkpoint()const;
 
          bool push_block( const signed_block& b, uint32_t skip = skip_nothing );
+         /** pushes a block that is shared with the caller, which is neither copied nor packed again */
+         bool push_block( const shared_block_ptr& b, uint32_t skip = skip_nothing );
          processed_transaction push_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
-         bool _push_block( const signed_block& b );
-         processed_transaction _push_transaction( const signed_transaction& trx );
+         bool _push_block( const shared_block_ptr& b );
+         /**
+          * @param pre what was computed about trx beforehand, computed while applying it when null
+          * @param notify false leaves notifying the objects trx changed to the caller, which can then notify those
+          * of many transactions at once
+          */
+         processed_transaction _push_transaction( const signed_transaction& trx,
+                                                  const precomputed_transaction* pre = nullptr,
+                                                  bool notify = true );
+         /**
+          * @return the digests of each transaction, and their signing keys if the skip flags check signatures,
+          * computed in parallel.  A pending transaction whose authorities were checked against accounts that have
+          * not changed since keeps them, so that they are not checked again.
+          */
+         vector<precomputed_transaction> precompute_transactions( const vector<const signed_transaction*>& trxs );
+         /** forgets the authorities the pending transactions were checked against, before they are pushed again */
+         void clear_verified_authorities();
 
          ///@throws fc::exception if the proposed transaction fails to apply.
          processed_transaction push_proposal( const proposal_object& proposal );
@@ -398,6 +536,8 @@ namespace graphene { namespace chain {
          //Mark pop_undo() as protected -- we do not want outside calling pop_undo(); it should call pop_block() instead
          void pop_undo() { object_database::pop_undo(); }
          void notify_changed_objects();
+         /** notifies the objects changed by the transactions it restores once they are all pushed */
+         friend struct detail::pending_transactions_restorer;
 
       private:
          optional<undo_database::session>       _pending_tx_session;
@@ -411,7 +551,19 @@ namespace graphene { namespace chain {
          void                  apply_block( const signed_block& next_block, uint32_t skip = skip_nothing );
          processed_transaction apply_transaction( const signed_transaction& trx, uint32_t skip = skip_nothing );
          void                  _apply_block( const signed_block& next_block );
-         processed_transaction _apply_transaction( const signed_transaction& trx );
+         /** @param authorities_read set to the accounts whose authorities trx was checked against, if it was */
+         processed_transaction _apply_transaction( const signed_transaction& trx,
+                                                   const precomputed_transaction* pre = nullptr,
+                                                   optional< flat_set<account_id_type> >* authorities_read = nullptr );
+         /** adds the accounts and global properties changed in state to _authority_changes */
+         void                  note_authority_changes( const undo_state& state );
+         /** the fees of trx converted to the core asset, per kilobyte of pack_size */
+         uint64_t              core_fee_per_kb( const signed_transaction& trx, uint32_t pack_size )const;
+         /** appends a block to the block log and indexes its transactions */
+         void                  store_block( const shared_block_ptr& b );
+         /** reads a block from _block_id_to_block into the block cache, leaves the outputs alone if it is not there */
+         void                  load_block( const block_id_type& id, std::shared_ptr<const signed_block>* block,
+                                           std::shared_ptr<const vector<char>>* packed = nullptr )const;
          operation_result      apply_operation( transaction_evaluation_state& eval_state, const operation& op );
 
 
@@ -421,6 +573,22 @@ namespace graphene { namespace chain {
          const witness_object& validate_block_header( uint32_t skip, const signed_block& next_block )const;
          const witness_object& _validate_block_header( const signed_block& next_block )const;
          void create_block_summary(const signed_block& next_block);
+         void write_state_checkpoint();
+         /** @return the latest a transaction valid at the head block can expire, the keys of signatures are not cached past it */
+         fc::time_point_sec max_signature_cache_expiration()const;
+         void log_index_statistics();
+         void update_head_state_digest();
+
+         //////////////////// db_management.cpp ////////////////////
+         /** replays the blocks of the block log after the head block and starts the fork database */
+         void catch_up_with_block_log();
+         void pop_reversible_blocks();
+         /** @return where @ref open_from_snapshot keeps the snapshot the block log in data_dir starts from */
+         static fc::path snapshot_base_dir( const fc::path& data_dir );
+         /** opens the transaction id index if it is enabled and adds the blocks of the block log it lacks */
+         void open_transaction_id_index( const fc::path& data_dir );
+         /** @return the state digest, computing it once if it is not maintained */
+         fc::sha256 full_state_digest();
 
          //////////////////// db_update.cpp ////////////////////
          void update_global_dynamic_data( const signed_block& b );
@@ -452,7 +620,7 @@ namespace graphene { namespace chain {
          ///@}
          ///@}
 
-         vector< processed_transaction >        _pending_tx;
+         transaction_pool                       _pending_tx;
          fork_database                          _fork_db;
 
          /**
@@ -465,6 +633,25 @@ namespace graphene { namespace chain {
           *  the fork tree relatively simple.
           */
          block_database   _block_id_to_block;
+         /** blocks read back from _block_id_to_block, shared by all readers */
+         mutable block_cache _block_cache;
+         transaction_id_index _transaction_id_index;
+         bool                 _transaction_id_index_enabled = false;
+         signature_recovery_pool _signature_recovery;
+         signature_cache      _signature_cache;
+
+         struct verified_authority
+         {
+            vector<signature_type>     signatures;
+            flat_set<account_id_type>  accounts;
+         };
+         /** the accounts whose authorities each pending transaction was checked against, by transaction id */
+         std::unordered_map<transaction_id_type, verified_authority, std::hash<fc::ripemd160>> _verified_authorities;
+         /**
+          * accounts and global properties changed by the pending transactions and by the blocks pushed or popped
+          * since _verified_authorities was cleared
+          */
+         flat_set<object_id_type>          _authority_changes;
 
          /**
           * Contains the set of ops that are in the process of being applied from
@@ -486,6 +673,15 @@ namespace graphene { namespace chain {
 
          flat_map<uint32_t,block_id_type>  _checkpoints;
 
+         uint32_t                          _state_checkpoint_interval = 0;
+         uint32_t                          _state_checkpoints_per_merge = 0;
+
+         uint32_t                          _index_statistics_interval = 0;
+         uint32_t                          _last_index_statistics_block = 0;
+         vector<index_statistics>          _last_index_statistics;
+
+         fc::sha256                        _head_state_digest;
+
          node_property_object              _node_property_object;
    };
 
@@ -509,3 +705,5 @@ namespace graphene { namespace chain {
    }
 
 } }
+
+FC_REFLECT( graphene::chain::snapshot_manifest, (block_num)(block_id)(chain_id)(state_digest)(head_block) )
@@ -62,6 +62,15 @@ struct skip_flags_restorer
  *
  * TODO:  Change the name of this class to better reflect the fact
  * that it restores popped transactions as well as pending transactions.
+ *
+ * Every transaction that did not expire is evaluated again.  What can be
+ * known not to have changed is skipped: their keys are recovered in parallel
+ * or found in the signature cache, their authorities are only verified again
+ * when an account they were verified against changed, and the objects they
+ * changed are notified once for all of them.  Skipping the evaluation as well
+ * would take the set of objects each one read, which is not tracked: the
+ * evaluators read the head block time, which every block changes, and look
+ * objects up through ordered indexes rather than by id.
  */
 struct pending_transactions_restorer
 {
@@ -73,26 +82,31 @@ struct pending_transactions_restorer
 
    ~pending_transactions_restorer()
    {
+      // digest and recover the keys of every transaction at once, they are all checked again below; the ones
+      // that expired in the meantime can only fail and are dropped without applying them
+      const bool check_expiration = _db.head_block_num() > 0;
+      const fc::time_point_sec now = _db.head_block_time();
+      std::vector<const signed_transaction*> trxs;
+      trxs.reserve( _db._popped_tx.size() + _pending_transactions.size() );
       for( const auto& tx : _db._popped_tx )
-      {
-         try {
-            if( !_db.is_known_transaction( tx.id() ) ) {
-               // since push_transaction() takes a signed_transaction,
-               // the operation_results field will be ignored.
-               _db._push_transaction( tx );
-            }
-         } catch ( const fc::exception&  ) {
-         }
-      }
-      _db._popped_tx.clear();
-      for( const processed_transaction& tx : _pending_transactions )
+         if( !check_expiration || tx.expiration >= now )
+            trxs.push_back( &tx );
+      for( const auto& tx : _pending_transactions )
+         if( !check_expiration || tx.expiration >= now )
+            trxs.push_back( &tx );
+      const auto precomputed = _db.precompute_transactions( trxs );
+      _db.clear_verified_authorities();
+
+      size_t restored = 0;
+      for( size_t i = 0; i < trxs.size(); ++i )
       {
          try
          {
-            if( !_db.is_known_transaction( tx.id() ) ) {
+            if( !_db.is_known_transaction( precomputed[i].digests.id ) ) {
                // since push_transaction() takes a signed_transaction,
                // the operation_results field will be ignored.
-               _db._push_transaction( tx );
+               _db._push_transaction( *trxs[i], &precomputed[i], false );
+               ++restored;
             }
          }
          catch( const fc::exception& e )
@@ -103,6 +117,20 @@ struct pending_transactions_restorer
             */
          }
       }
+      _db._popped_tx.clear();
+
+      // the pending state now holds the changes of every transaction restored
+      if( restored > 0 )
+      {
+         try
+         {
+            _db.notify_changed_objects();
+         }
+         catch( const fc::exception& e )
+         {
+            elog( "Unable to notify the objects changed by the pending transactions: ${e}", ("e", e.to_detail_string()) );
+         }
+      }
    }
 
    database& _db;
@@ -20,6 +20,7 @@
  */
 #pragma once
 #include <graphene/chain/protocol/block.hpp>
+#include <graphene/chain/shared_block.hpp>
 
 #include <boost/multi_index_container.hpp>
 #include <boost/multi_index/member.hpp>
@@ -34,10 +35,11 @@ namespace graphene { namespace chain {
 
    struct fork_item
    {
-      fork_item( signed_block d )
-      :num(d.block_num()),id(d.id()),data( std::move(d) ){}
+      fork_item( shared_block_ptr b )
+      :num(b->block_num()),id(b->id()),block( std::move(b) ){}
 
-      block_id_type previous_id()const { return data.previous; }
+      const signed_block& data()const { return block->block(); }
+      block_id_type previous_id()const { return data().previous; }
 
       weak_ptr< fork_item > prev;
       uint32_t              num;    // initialized in ctor
@@ -47,7 +49,7 @@ namespace graphene { namespace chain {
        */
       bool                  invalid = false;
       block_id_type         id;
-      signed_block          data;
+      shared_block_ptr      block;
    };
    typedef shared_ptr<fork_item> item_ptr;
 
@@ -61,6 +63,11 @@ namespace graphene { namespace chain {
     *
     *  Every time a block is pushed into the fork DB the
     *  block with the highest block_num will be returned.
+    *
+    *  A block whose previous block is not known yet is kept
+    *  aside, up to a limit on the number of such blocks and
+    *  their size, and linked as soon as its previous block
+    *  is pushed.
     */
    class fork_database
    {
@@ -72,17 +79,21 @@ namespace graphene { namespace chain {
          fork_database();
          void reset();
 
-         void                             start_block(signed_block b);
+         void                             start_block(shared_block_ptr b);
+         /** removes the block and every block built on it, including those kept until they link */
          void                             remove(block_id_type b);
          void                             set_head(shared_ptr<fork_item> h);
+         /** only the blocks linked to the chain are known, see @ref fetch_unlinked_block for the others */
          bool                             is_known_block(const block_id_type& id)const;
          shared_ptr<fork_item>            fetch_block(const block_id_type& id)const;
+         /** @return a block kept until its previous block arrives, which has not been validated in any way */
+         shared_ptr<fork_item>            fetch_unlinked_block(const block_id_type& id)const;
          vector<item_ptr>                 fetch_block_by_number(uint32_t n)const;
 
          /**
           *  @return the new head block ( the longest fork )
           */
-         shared_ptr<fork_item>            push_block(const signed_block& b);
+         shared_ptr<fork_item>            push_block(const shared_block_ptr& b);
          shared_ptr<fork_item>            head()const { return _head; }
          void                             pop_block();
 
@@ -106,13 +117,25 @@ namespace graphene { namespace chain {
          > fork_multi_index_type;
 
          void set_max_size( uint32_t s );
+         /** limits the blocks kept until they link, those furthest ahead are dropped first */
+         void set_max_unlinked( uint32_t blocks, uint64_t bytes );
+         size_t unlinked_count()const { return _unlinked_index.size(); }
 
       private:
          /** @return a pointer to the newly pushed item */
          void _push_block(const item_ptr& b );
          void _push_next(const item_ptr& newly_inserted);
+         void _push_unlinked(const item_ptr& item);
+         /** drops the unlinked blocks furthest ahead until the rest are within the limits */
+         void _trim_unlinked();
+         /** drops the unlinked blocks numbered below min_num */
+         void _prune_unlinked(uint32_t min_num);
 
          uint32_t                 _max_size = 1024;
+         uint32_t                 _max_unlinked_blocks = MAX_BLOCK_REORDERING;
+         uint64_t                 _max_unlinked_bytes = 64 * 1024 * 1024;
+         /** packed size of the blocks in _unlinked_index */
+         uint64_t                 _unlinked_bytes = 0;
 
          fork_multi_index_type    _unlinked_index;
          fork_multi_index_type    _index;
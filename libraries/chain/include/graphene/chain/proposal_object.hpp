@@ -69,6 +69,7 @@ class required_approval_index : public secondary_index
       virtual void object_removed( const object& obj ) override;
       virtual void about_to_modify( const object& before ) override{};
       virtual void object_modified( const object& after  ) override{};
+      virtual void clear() override { _account_to_proposals.clear(); }
 
       void remove( account_id_type a, proposal_id_type p );
 
@@ -112,6 +112,18 @@ namespace graphene { namespace chain {
       void get_required_authorities( flat_set<account_id_type>& active, flat_set<account_id_type>& owner, vector<authority>& other )const;
    };
 
+   /**
+    *  @brief the id, signature digest and packed size of a signed transaction
+    */
+   struct transaction_digests
+   {
+      transaction_id_type   id;
+      /** only computed when the chain id is given to signed_transaction::compute_digests() */
+      optional<digest_type> sig_digest;
+      /** of the signed transaction, without the results of a processed transaction */
+      uint32_t              pack_size = 0;
+   };
+
    /**
     *  @brief adds a signature to a transaction
     */
@@ -147,6 +159,13 @@ namespace graphene { namespace chain {
          const std::function<const authority*(account_id_type)>& get_owner,
          uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH )const;
 
+      /** same as above, with the keys returned by get_signature_keys() recovered beforehand */
+      void verify_authority(
+         const flat_set<public_key_type>& signature_keys,
+         const std::function<const authority*(account_id_type)>& get_active,
+         const std::function<const authority*(account_id_type)>& get_owner,
+         uint32_t max_recursion = GRAPHENE_MAX_SIG_CHECK_DEPTH )const;
+
       /**
        * This is a slower replacement for get_required_signatures()
        * which returns a minimal set in all cases, including
@@ -164,6 +183,12 @@ namespace graphene { namespace chain {
 
       flat_set<public_key_type> get_signature_keys( const chain_id_type& chain_id )const;
 
+      /**
+       * Computes id(), sig_digest() and the packed size from a single serialization of the transaction, instead
+       * of serializing it once for each of them.
+       */
+      transaction_digests compute_digests( const chain_id_type* chain_id = nullptr )const;
+
       vector<signature_type> signatures;
 
       /// Removes all operations and signatures
@@ -0,0 +1,58 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+#include <memory>
+#include <mutex>
+
+namespace graphene { namespace chain {
+
+   /**
+    *  @brief an immutable block shared by the fork database, the block log, the block cache and the network
+    *
+    *  The id and the serialized form of the block are computed at most once, so a block that is pushed,
+    *  stored and served to peers is never copied or packed again along the way.  All methods may be called
+    *  from any thread.
+    */
+   class shared_block
+   {
+      public:
+         explicit shared_block( signed_block b );
+         explicit shared_block( std::shared_ptr<const signed_block> b );
+
+         const signed_block&                         block()const { return *_block; }
+         /** @return the block, owned together with this object */
+         const std::shared_ptr<const signed_block>&  block_ptr()const { return _block; }
+         const block_id_type&                        id()const { return _id; }
+         uint32_t                                    block_num()const { return block_header::num_from_id( _id ); }
+         /** @return the packed block, packed by the first caller */
+         const std::shared_ptr<const vector<char>>&  packed()const;
+
+      private:
+         std::shared_ptr<const signed_block>          _block;
+         block_id_type                                _id;
+         mutable std::once_flag                       _packed_once;
+         mutable std::shared_ptr<const vector<char>>  _packed;
+   };
+   typedef std::shared_ptr<const shared_block> shared_block_ptr;
+
+} }
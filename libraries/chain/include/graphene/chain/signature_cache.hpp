@@ -0,0 +1,127 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/identity.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+
+#include <mutex>
+
+namespace graphene { namespace chain {
+
+   struct signature_cache_statistics
+   {
+      uint32_t capacity = 0;
+      uint32_t key_count = 0;
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t evictions = 0;
+   };
+
+   /**
+    *  @brief remembers the public key recovered from each signature
+    *
+    *  A pending transaction is checked when it arrives, again after every block is pushed and again when a block
+    *  is generated.  The key of a signature only depends on the signature and the digest it signs, so it is
+    *  recovered once and looked up afterwards.  A key is kept until the transaction it came from expires, or
+    *  until the cache is full and the key expiring first makes room.  All methods may be called from any thread.
+    */
+   class signature_cache
+   {
+      public:
+         /** a capacity of 0 disables the cache */
+         void                     set_capacity( uint32_t key_count );
+         bool                     enabled()const;
+
+         /**
+          * same as signed_transaction::get_signature_keys(), only recovering the keys it has not seen
+          * @param sig_digest the signature digest of trx
+          * @param max_expiration the latest a transaction that is valid can expire, the keys of trx are not kept
+          * past it whatever expiration trx claims
+          */
+         flat_set<public_key_type> get_signature_keys( const signed_transaction& trx, const digest_type& sig_digest,
+                                                       fc::time_point_sec max_expiration );
+         /** forgets the keys of transactions that expired before now */
+         void                     remove_expired( fc::time_point_sec now );
+         void                     clear();
+
+         signature_cache_statistics get_statistics()const;
+
+      private:
+         struct entry
+         {
+            digest_type          digest;
+            signature_type       signature;
+            public_key_type      key;
+            fc::time_point_sec   expiration;
+         };
+         struct entry_key
+         {
+            const digest_type&    digest;
+            const signature_type& signature;
+         };
+         struct entry_hash
+         {
+            size_t operator()( const entry& e )const { return hash( e.digest, e.signature ); }
+            size_t operator()( const entry_key& k )const { return hash( k.digest, k.signature ); }
+            static size_t hash( const digest_type& digest, const signature_type& signature );
+         };
+         struct entry_equal
+         {
+            bool operator()( const entry& a, const entry& b )const
+            { return a.digest == b.digest && a.signature == b.signature; }
+            bool operator()( const entry_key& a, const entry& b )const
+            { return a.digest == b.digest && a.signature == b.signature; }
+            bool operator()( const entry& a, const entry_key& b )const
+            { return a.digest == b.digest && a.signature == b.signature; }
+         };
+         struct by_signature;
+         struct by_expiration;
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::hashed_unique< boost::multi_index::tag<by_signature>,
+                  boost::multi_index::identity<entry>, entry_hash, entry_equal >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_expiration>,
+                  boost::multi_index::member<entry, fc::time_point_sec, &entry::expiration> >
+            >
+         > entry_index_type;
+
+         /** @return false if the key of signature over digest is not cached */
+         bool                     find( const digest_type& digest, const signature_type& signature, public_key_type& key );
+         void                     put( const digest_type& digest, const signature_type& signature,
+                                       const public_key_type& key, fc::time_point_sec expiration );
+
+         uint32_t                 _capacity = 0;
+         uint64_t                 _hits = 0;
+         uint64_t                 _misses = 0;
+         uint64_t                 _evictions = 0;
+         entry_index_type         _entries;
+         mutable std::mutex       _mutex;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::signature_cache_statistics, (capacity)(key_count)(hits)(misses)(evictions) )
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <functional>
+#include <memory>
+
+namespace fc { class thread; }
+
+namespace graphene { namespace chain {
+
+   /** what is computed about a transaction before it is applied, so that applying it computes none of it again */
+   struct precomputed_transaction
+   {
+      transaction_digests                    digests;
+      /** the signing keys, unless signatures are not checked or could not be recovered */
+      optional< flat_set<public_key_type> >  signature_keys;
+      /**
+       * the accounts whose authorities the transaction was already checked against, if none of them changed
+       * since, so that it is not checked again
+       */
+      optional< flat_set<account_id_type> >  verified_authorities;
+   };
+
+   /**
+    *  @brief computes the digests and recovers the signing keys of a batch of transactions on worker threads
+    *
+    *  Recovering the public key of each signature is the most expensive part of checking a transaction, and no
+    *  transaction depends on another for it, so a batch is shared between the workers and the calling thread.
+    *  precompute() returns once the whole batch is done.
+    */
+   class signature_recovery_pool
+   {
+      public:
+         typedef std::function<flat_set<public_key_type>( const signed_transaction&, const digest_type& )> key_getter;
+
+         /** a thread_count of 0 does all the work on the calling thread */
+         void                     set_thread_count( uint32_t thread_count );
+         uint32_t                 thread_count()const { return _workers.size(); }
+
+         /**
+          * @return the digests of each transaction in the order given, and the keys get_keys returns for its
+          * signature digest if get_keys is set.  get_keys is called from several threads at once.
+          * A transaction with a bad or duplicate signature gets no keys so that checking it again reports the
+          * error the usual way.
+          */
+         vector<precomputed_transaction> precompute( const chain_id_type& chain_id,
+                                                     const vector<const signed_transaction*>& trxs,
+                                                     const key_getter& get_keys );
+
+      private:
+         vector< std::shared_ptr<fc::thread> > _workers;
+   };
+
+} } // graphene::chain
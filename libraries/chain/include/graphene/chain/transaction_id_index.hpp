@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/chain/protocol/block.hpp>
+
+#include <memory>
+#include <mutex>
+
+namespace fc { class file_mapping; class mapped_region; }
+
+namespace graphene { namespace chain {
+
+   /** where a transaction was included in a block */
+   struct transaction_location
+   {
+      uint32_t block_num = 0;
+      uint16_t trx_in_block = 0;
+   };
+
+   /**
+    *  @brief maps the id of every transaction in the block log to the block that contains it
+    *
+    *  The "index" file is an open addressing hash table that is memory mapped and doubled in size when it gets
+    *  half full.  Entries are only ever added: the entries of blocks that are popped or replaced on a fork
+    *  switch stay behind, so a location returned by find() must be checked against the block it points at.
+    *  Each entry keeps only 64 bits of the transaction id, which makes such a check necessary anyway.
+    *
+    *  All const methods may be called from any thread, concurrently with add_block().
+    */
+   class transaction_id_index
+   {
+      public:
+         transaction_id_index();
+         ~transaction_id_index();
+
+         void open( const fc::path& dir );
+         bool is_open()const;
+         void close();
+         /** removes every entry */
+         void clear();
+
+         void add_block( const signed_block& b );
+         /** adds the entries of a block whose transaction ids are already known */
+         void add_block( uint32_t block_num, const vector<transaction_id_type>& trx_ids );
+
+         /** @return the candidate locations of the transaction */
+         vector<transaction_location> find( const transaction_id_type& id )const;
+         /** @return the highest block number added */
+         uint32_t                     indexed_through()const;
+
+      private:
+         struct header;
+         struct slot;
+
+         header&     get_header()const;
+         slot*       slots()const;
+         void        map( uint64_t slot_count );
+         /** rebuilds the table with twice as many slots */
+         void        grow();
+         void        insert( uint64_t key, uint32_t block_num, uint16_t trx_in_block );
+
+         fc::path                            _path;
+         std::unique_ptr<fc::file_mapping>   _file;
+         std::unique_ptr<fc::mapped_region>  _region;
+         /** guards the mapping, which grow() replaces */
+         mutable std::mutex                  _mutex;
+   };
+} }
+
+FC_REFLECT( graphene::chain::transaction_location, (block_num)(trx_in_block) )
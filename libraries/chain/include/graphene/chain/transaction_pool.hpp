@@ -0,0 +1,145 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/chain/protocol/transaction.hpp>
+
+#include <boost/multi_index_container.hpp>
+#include <boost/multi_index/composite_key.hpp>
+#include <boost/multi_index/member.hpp>
+#include <boost/multi_index/hashed_index.hpp>
+#include <boost/multi_index/ordered_index.hpp>
+#include <boost/multi_index/sequenced_index.hpp>
+
+namespace graphene { namespace chain {
+
+   struct transaction_pool_statistics
+   {
+      uint32_t transaction_count = 0;
+      uint64_t byte_count = 0;
+      uint64_t max_bytes = 0;
+      uint32_t max_per_account = 0;
+      uint64_t evictions = 0;
+      uint64_t rejections = 0;
+   };
+
+   /**
+    *  @brief the transactions waiting to be included in a block
+    *
+    *  Every pending transaction is indexed by id, arrival, expiration, the core fee it pays per kilobyte and the
+    *  account paying it.  The pool can be limited to a number of bytes, in which case a transaction that does not
+    *  fit only gets in by paying more per kilobyte than the expired and cheapest ones it pushes out, and to a
+    *  number of transactions paid by any single account.  Blocks are built from the best paying transactions.
+    */
+   class transaction_pool
+   {
+      public:
+         struct entry
+         {
+            processed_transaction trx;
+            transaction_id_type   id;
+            account_id_type       fee_payer;
+            fc::time_point_sec    expiration;
+            uint32_t              pack_size;
+            uint64_t              fee_per_kb;
+            uint64_t              sequence;
+         };
+
+         /** 0 leaves the size of the pool, or the number of transactions paid by one account, unlimited */
+         void                     set_limits( uint64_t max_bytes, uint32_t max_per_account );
+
+         /**
+          * checks that a transaction can be added without applying it first
+          * @throws pending_account_limit_exceeded if fee_payer already pays for as many transactions as allowed
+          * @throws pending_pool_full if no room can be made by evicting transactions that expired before now or
+          * pay less than fee_per_kb
+          */
+         void                     check_admission( account_id_type fee_payer, uint32_t pack_size, uint64_t fee_per_kb,
+                                                   fc::time_point_sec now );
+         /** whether a transaction of pack_size bytes fits without evicting anything */
+         bool                     has_room( uint32_t pack_size )const;
+         /**
+          * evicts the transactions a transaction that passed check_admission() needs room from; the caller is left
+          * to drop their changes from the pending state
+          */
+         void                     evict_for( uint32_t pack_size, uint64_t fee_per_kb, fc::time_point_sec now );
+         /** adds a transaction that passed check_admission() and has room, unless it is already pending */
+         void                     insert( const processed_transaction& trx, const transaction_id_type& id,
+                                          account_id_type fee_payer, uint32_t pack_size, uint64_t fee_per_kb );
+
+         bool                     contains( const transaction_id_type& id )const;
+         size_t                   size()const { return _entries.size(); }
+         bool                     empty()const { return _entries.empty(); }
+         void                     clear();
+
+         /** empties the pool, returning its transactions in the order they arrived */
+         vector<processed_transaction> release();
+         /** the transactions paying the most per kilobyte first, those paying the same in the order they arrived */
+         vector<const entry*>     by_priority()const;
+
+         transaction_pool_statistics get_statistics()const;
+
+      private:
+         struct by_arrival;
+         struct by_id;
+         struct by_expiration;
+         struct by_fee;
+         struct by_fee_payer;
+         typedef boost::multi_index_container<
+            entry,
+            boost::multi_index::indexed_by<
+               boost::multi_index::sequenced< boost::multi_index::tag<by_arrival> >,
+               boost::multi_index::hashed_unique< boost::multi_index::tag<by_id>,
+                  boost::multi_index::member<entry, transaction_id_type, &entry::id>, std::hash<fc::ripemd160> >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_expiration>,
+                  boost::multi_index::member<entry, fc::time_point_sec, &entry::expiration> >,
+               boost::multi_index::ordered_unique< boost::multi_index::tag<by_fee>,
+                  boost::multi_index::composite_key< entry,
+                     boost::multi_index::member<entry, uint64_t, &entry::fee_per_kb>,
+                     boost::multi_index::member<entry, uint64_t, &entry::sequence>
+                  >,
+                  boost::multi_index::composite_key_compare< std::greater<uint64_t>, std::less<uint64_t> >
+               >,
+               boost::multi_index::ordered_non_unique< boost::multi_index::tag<by_fee_payer>,
+                  boost::multi_index::member<entry, account_id_type, &entry::fee_payer> >
+            >
+         > entry_index_type;
+
+         /**
+          * frees pack_size bytes, first from expired transactions and then from the ones paying the least
+          * @param evict false only checks whether enough bytes can be freed
+          * @return false if the transactions paying less than fee_per_kb do not free enough
+          */
+         bool                     make_room( uint32_t pack_size, uint64_t fee_per_kb, fc::time_point_sec now, bool evict );
+         void                     erase( entry_index_type::index<by_arrival>::type::iterator itr );
+
+         uint64_t                 _max_bytes = 0;
+         uint32_t                 _max_per_account = 0;
+         uint64_t                 _byte_count = 0;
+         uint64_t                 _next_sequence = 0;
+         uint64_t                 _evictions = 0;
+         uint64_t                 _rejections = 0;
+         entry_index_type         _entries;
+   };
+
+} } // graphene::chain
+
+FC_REFLECT( graphene::chain::transaction_pool_statistics,
+            (transaction_count)(byte_count)(max_bytes)(max_per_account)(evictions)(rejections) )
@@ -310,6 +310,29 @@ flat_set<public_key_type> signed_transaction::get_signature_keys( const chain_id
 
 
 
+transaction_digests signed_transaction::compute_digests( const chain_id_type* chain_id )const
+{
+   // a signed transaction packs as the transaction followed by its signatures
+   const vector<char> packed = fc::raw::pack( *this );
+   const size_t trx_size = packed.size() - fc::raw::pack_size( signatures );
+
+   transaction_digests result;
+   digest_type::encoder enc;
+   enc.write( packed.data(), trx_size );
+   const digest_type h = enc.result();
+   memcpy( result.id._hash, h._hash, std::min( sizeof(result.id), sizeof(h) ) );
+
+   if( chain_id )
+   {
+      digest_type::encoder sig_enc;
+      fc::raw::pack( sig_enc, *chain_id );
+      sig_enc.write( packed.data(), trx_size );
+      result.sig_digest = sig_enc.result();
+   }
+   result.pack_size = packed.size();
+   return result;
+}
+
 set<public_key_type> signed_transaction::get_required_signatures(
    const chain_id_type& chain_id,
    const flat_set<public_key_type>& available_keys,
@@ -380,4 +403,13 @@ void signed_transaction::verify_authority(
    graphene::chain::verify_authority( operations, get_signature_keys( chain_id ), get_active, get_owner, max_recursion );
 } FC_CAPTURE_AND_RETHROW( (*this) ) }
 
+void signed_transaction::verify_authority(
+   const flat_set<public_key_type>& signature_keys,
+   const std::function<const authority*(account_id_type)>& get_active,
+   const std::function<const authority*(account_id_type)>& get_owner,
+   uint32_t max_recursion )const
+{ try {
+   graphene::chain::verify_authority( operations, signature_keys, get_active, get_owner, max_recursion );
+} FC_CAPTURE_AND_RETHROW( (*this) ) }
+
 } } // graphene::chain
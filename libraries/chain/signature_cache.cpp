@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/signature_cache.hpp>
+#include <graphene/chain/exceptions.hpp>
+
+#include <cstring>
+
+namespace graphene { namespace chain {
+
+size_t signature_cache::entry_hash::hash( const digest_type& digest, const signature_type& signature )
+{
+   // both are already uniformly distributed, the first byte of a signature only holds the recovery id
+   size_t d, s;
+   memcpy( &d, digest.data(), sizeof(d) );
+   memcpy( &s, signature.begin() + 1, sizeof(s) );
+   return d ^ s;
+}
+
+void signature_cache::set_capacity( uint32_t key_count )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _capacity = key_count;
+   auto& by_exp_idx = _entries.get<by_expiration>();
+   while( _entries.size() > _capacity )
+   {
+      by_exp_idx.erase( by_exp_idx.begin() );
+      ++_evictions;
+   }
+}
+
+bool signature_cache::enabled()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return _capacity > 0;
+}
+
+flat_set<public_key_type> signature_cache::get_signature_keys( const signed_transaction& trx, const digest_type& sig_digest,
+                                                               fc::time_point_sec max_expiration )
+{ try {
+   // the keys are looked up before the transaction is validated, so its expiration can not be trusted yet
+   const fc::time_point_sec expiration = std::min( trx.expiration, max_expiration );
+   const bool use_cache = enabled();
+   flat_set<public_key_type> result;
+   for( const auto& sig : trx.signatures )
+   {
+      public_key_type key;
+      if( !use_cache )
+         key = fc::ecc::public_key( sig, sig_digest );
+      else if( !find( sig_digest, sig, key ) )
+      {
+         key = fc::ecc::public_key( sig, sig_digest );
+         put( sig_digest, sig, key, expiration );
+      }
+      GRAPHENE_ASSERT(
+         result.insert( key ).second,
+         tx_duplicate_sig,
+         "Duplicate Signature detected" );
+   }
+   return result;
+} FC_CAPTURE_AND_RETHROW() }
+
+bool signature_cache::find( const digest_type& digest, const signature_type& signature, public_key_type& key )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto& by_sig_idx = _entries.get<by_signature>();
+   auto itr = by_sig_idx.find( entry_key{ digest, signature }, entry_hash(), entry_equal() );
+   if( itr == by_sig_idx.end() )
+   {
+      ++_misses;
+      return false;
+   }
+   ++_hits;
+   key = itr->key;
+   return true;
+}
+
+void signature_cache::put( const digest_type& digest, const signature_type& signature,
+                           const public_key_type& key, fc::time_point_sec expiration )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( _capacity == 0 )
+      return;
+   auto& by_exp_idx = _entries.get<by_expiration>();
+   if( _entries.size() >= _capacity )
+   {
+      // the transaction expiring first has the least time left to be checked again
+      by_exp_idx.erase( by_exp_idx.begin() );
+      ++_evictions;
+   }
+   _entries.insert( entry{ digest, signature, key, expiration } );
+}
+
+void signature_cache::remove_expired( fc::time_point_sec now )
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   auto& by_exp_idx = _entries.get<by_expiration>();
+   by_exp_idx.erase( by_exp_idx.begin(), by_exp_idx.lower_bound( now ) );
+}
+
+void signature_cache::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _entries.clear();
+}
+
+signature_cache_statistics signature_cache::get_statistics()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   signature_cache_statistics s;
+   s.capacity  = _capacity;
+   s.key_count = _entries.size();
+   s.hits      = _hits;
+   s.misses    = _misses;
+   s.evictions = _evictions;
+   return s;
+}
+
+} } // graphene::chain
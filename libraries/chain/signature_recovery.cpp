@@ -0,0 +1,77 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/signature_recovery.hpp>
+
+#include <fc/thread/thread.hpp>
+
+#include <atomic>
+
+namespace graphene { namespace chain {
+
+void signature_recovery_pool::set_thread_count( uint32_t thread_count )
+{
+   if( thread_count == _workers.size() )
+      return;
+   _workers.clear();
+   for( uint32_t i = 0; i < thread_count; ++i )
+      _workers.push_back( std::make_shared<fc::thread>( "sig_recovery_" + fc::to_string( uint64_t(i) ) ) );
+}
+
+vector<precomputed_transaction> signature_recovery_pool::precompute( const chain_id_type& chain_id,
+                                                                     const vector<const signed_transaction*>& trxs,
+                                                                     const key_getter& get_keys )
+{
+   vector<precomputed_transaction> result( trxs.size() );
+   if( trxs.empty() )
+      return result;
+
+   // transactions are handed out one at a time, since their signature counts differ
+   std::atomic<size_t> next( 0 );
+   auto work = [&]() {
+      for( size_t i = next++; i < trxs.size(); i = next++ )
+      {
+         precomputed_transaction& r = result[i];
+         r.digests = trxs[i]->compute_digests( get_keys ? &chain_id : nullptr );
+         if( !get_keys )
+            continue;
+         try
+         {
+            r.signature_keys = get_keys( *trxs[i], *r.digests.sig_digest );
+         }
+         catch( const fc::exception& )
+         {
+            // left invalid for the caller to report
+         }
+      }
+   };
+
+   const size_t helpers = std::min<size_t>( _workers.size(), trxs.size() - 1 );
+   vector< fc::future<void> > done;
+   done.reserve( helpers );
+   for( size_t i = 0; i < helpers; ++i )
+      done.push_back( _workers[i]->async( work, "precompute transactions" ) );
+   work();
+   for( auto& f : done )
+      f.wait();
+   return result;
+}
+
+} } // graphene::chain
@@ -0,0 +1,237 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/transaction_id_index.hpp>
+#include <fc/interprocess/file_mapping.hpp>
+
+#include <cstring>
+#include <fstream>
+#include <limits>
+
+namespace graphene { namespace chain {
+
+struct transaction_id_index::header
+{
+   uint64_t magic = 0;
+   uint64_t slot_count = 0;
+   uint64_t entry_count = 0;
+   uint32_t indexed_through = 0;
+   uint32_t reserved = 0;
+};
+
+/** an empty slot has block_num 0, no transaction is in a block numbered 0 */
+struct transaction_id_index::slot
+{
+   uint64_t key = 0;
+   uint32_t block_num = 0;
+   uint16_t trx_in_block = 0;
+   uint16_t reserved = 0;
+};
+
+namespace {
+   const uint64_t index_magic = 0x5452584944583031ull;
+   const uint64_t initial_slot_count = 1 << 16;
+
+   uint64_t key_of( const transaction_id_type& id )
+   {
+      // transaction ids are hashes, so any 64 of their bits are as good a hash as any
+      uint64_t key;
+      memcpy( &key, id.data(), sizeof(key) );
+      return key;
+   }
+}
+
+transaction_id_index::transaction_id_index() {}
+
+transaction_id_index::~transaction_id_index()
+{
+   close();
+}
+
+void transaction_id_index::open( const fc::path& dir )
+{ try {
+   close();
+   fc::create_directories( dir );
+   _path = dir / "index";
+   fc::remove( dir / "index.tmp" );
+
+   std::lock_guard<std::mutex> lock( _mutex );
+   uint64_t slot_count = initial_slot_count;
+   if( fc::exists( _path ) && fc::file_size( _path ) >= sizeof(header) )
+   {
+      header h;
+      std::ifstream in( _path.generic_string().c_str(), std::ifstream::binary );
+      in.read( (char*)&h, sizeof(h) );
+      if( h.magic == index_magic && fc::file_size( _path ) == sizeof(header) + h.slot_count * sizeof(slot) )
+         slot_count = h.slot_count;
+      else
+      {
+         wlog( "Discarding the unrecognized transaction id index ${f}", ("f",_path) );
+         fc::remove( _path );
+      }
+   }
+   map( slot_count );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+bool transaction_id_index::is_open()const
+{
+   return _region != nullptr;
+}
+
+void transaction_id_index::close()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _region.reset();
+   _file.reset();
+}
+
+void transaction_id_index::map( uint64_t slot_count )
+{
+   const bool created = !fc::exists( _path );
+   if( created )
+      std::ofstream( _path.generic_string().c_str(), std::ofstream::binary );
+   if( fc::file_size( _path ) != sizeof(header) + slot_count * sizeof(slot) )
+      fc::resize_file( _path, sizeof(header) + slot_count * sizeof(slot) );
+
+   _region.reset();
+   _file.reset( new fc::file_mapping( _path.generic_string().c_str(), fc::read_write ) );
+   _region.reset( new fc::mapped_region( *_file, fc::read_write ) );
+   if( created )
+   {
+      header& h = get_header();
+      h.magic = index_magic;
+      h.slot_count = slot_count;
+   }
+}
+
+transaction_id_index::header& transaction_id_index::get_header()const
+{
+   return *static_cast<header*>( _region->get_address() );
+}
+
+transaction_id_index::slot* transaction_id_index::slots()const
+{
+   return reinterpret_cast<slot*>( static_cast<char*>( _region->get_address() ) + sizeof(header) );
+}
+
+void transaction_id_index::clear()
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   _region.reset();
+   _file.reset();
+   fc::remove( _path );
+   map( initial_slot_count );
+}
+
+void transaction_id_index::grow()
+{
+   const header old_header = get_header();
+   const fc::path tmp = _path.generic_string() + ".tmp";
+   {
+      std::ofstream( tmp.generic_string().c_str(), std::ofstream::binary );
+      const uint64_t slot_count = old_header.slot_count * 2;
+      fc::resize_file( tmp, sizeof(header) + slot_count * sizeof(slot) );
+      fc::file_mapping file( tmp.generic_string().c_str(), fc::read_write );
+      fc::mapped_region region( file, fc::read_write );
+      header& h = *static_cast<header*>( region.get_address() );
+      slot* new_slots = reinterpret_cast<slot*>( static_cast<char*>( region.get_address() ) + sizeof(header) );
+
+      const slot* old_slots = slots();
+      for( uint64_t i = 0; i < old_header.slot_count; ++i )
+      {
+         if( old_slots[i].block_num == 0 )
+            continue;
+         uint64_t s = old_slots[i].key & ( slot_count - 1 );
+         while( new_slots[s].block_num != 0 )
+            s = ( s + 1 ) & ( slot_count - 1 );
+         new_slots[s] = old_slots[i];
+      }
+      h = old_header;
+      h.slot_count = slot_count;
+   }
+   _region.reset();
+   _file.reset();
+   fc::rename( tmp, _path );
+   map( old_header.slot_count * 2 );
+}
+
+void transaction_id_index::insert( uint64_t key, uint32_t block_num, uint16_t trx_in_block )
+{
+   header& h = get_header();
+   slot* table = slots();
+   uint64_t s = key & ( h.slot_count - 1 );
+   for( ; table[s].block_num != 0; s = ( s + 1 ) & ( h.slot_count - 1 ) )
+      if( table[s].key == key && table[s].block_num == block_num && table[s].trx_in_block == trx_in_block )
+         return; // added again when blocks are replayed after a restart
+   table[s].key = key;
+   table[s].trx_in_block = trx_in_block;
+   table[s].block_num = block_num;
+   ++h.entry_count;
+}
+
+void transaction_id_index::add_block( const signed_block& b )
+{
+   vector<transaction_id_type> trx_ids;
+   trx_ids.reserve( b.transactions.size() );
+   for( const auto& trx : b.transactions )
+      trx_ids.push_back( trx.id() );
+   add_block( b.block_num(), trx_ids );
+}
+
+void transaction_id_index::add_block( uint32_t block_num, const vector<transaction_id_type>& trx_ids )
+{ try {
+   std::lock_guard<std::mutex> lock( _mutex );
+   FC_ASSERT( is_open() );
+   FC_ASSERT( trx_ids.size() <= std::numeric_limits<uint16_t>::max() );
+   while( ( get_header().entry_count + trx_ids.size() ) * 2 > get_header().slot_count )
+      grow();
+   for( uint16_t i = 0; i < trx_ids.size(); ++i )
+      insert( key_of( trx_ids[i] ), block_num, i );
+   header& h = get_header();
+   h.indexed_through = std::max( h.indexed_through, block_num );
+} FC_CAPTURE_AND_RETHROW( (block_num) ) }
+
+vector<transaction_location> transaction_id_index::find( const transaction_id_type& id )const
+{
+   vector<transaction_location> result;
+   std::lock_guard<std::mutex> lock( _mutex );
+   if( !is_open() )
+      return result;
+   const uint64_t key = key_of( id );
+   const uint64_t mask = get_header().slot_count - 1;
+   const slot* table = slots();
+   for( uint64_t s = key & mask; table[s].block_num != 0; s = ( s + 1 ) & mask )
+      if( table[s].key == key )
+      {
+         transaction_location loc;
+         loc.block_num = table[s].block_num;
+         loc.trx_in_block = table[s].trx_in_block;
+         result.push_back( loc );
+      }
+   return result;
+}
+
+uint32_t transaction_id_index::indexed_through()const
+{
+   std::lock_guard<std::mutex> lock( _mutex );
+   return is_open() ? get_header().indexed_through : 0;
+}
+
+} }
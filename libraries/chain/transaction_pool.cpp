@@ -0,0 +1,158 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/transaction_pool.hpp>
+#include <graphene/chain/exceptions.hpp>
+
+namespace graphene { namespace chain {
+
+void transaction_pool::set_limits( uint64_t max_bytes, uint32_t max_per_account )
+{
+   _max_bytes = max_bytes;
+   _max_per_account = max_per_account;
+}
+
+void transaction_pool::check_admission( account_id_type fee_payer, uint32_t pack_size, uint64_t fee_per_kb,
+                                        fc::time_point_sec now )
+{
+   if( _max_per_account > 0 && _entries.get<by_fee_payer>().count( fee_payer ) >= _max_per_account )
+   {
+      ++_rejections;
+      FC_THROW_EXCEPTION( pending_account_limit_exceeded, "Account ${a} already pays for ${n} pending transactions",
+                          ("a", fee_payer)("n", _max_per_account) );
+   }
+   if( !make_room( pack_size, fee_per_kb, now, false ) )
+   {
+      ++_rejections;
+      FC_THROW_EXCEPTION( pending_pool_full, "No room for a transaction of ${s} bytes paying ${f} per kilobyte",
+                          ("s", pack_size)("f", fee_per_kb) );
+   }
+}
+
+void transaction_pool::insert( const processed_transaction& trx, const transaction_id_type& id,
+                               account_id_type fee_payer, uint32_t pack_size, uint64_t fee_per_kb )
+{
+   FC_ASSERT( !contains( id ), "Transaction ${id} is already pending", ("id", id) );
+   FC_ASSERT( has_room( pack_size ), "No room for a transaction of ${s} bytes", ("s", pack_size) );
+   _entries.push_back( entry{ trx, id, fee_payer, trx.expiration, pack_size, fee_per_kb, _next_sequence++ } );
+   _byte_count += pack_size;
+}
+
+bool transaction_pool::has_room( uint32_t pack_size )const
+{
+   return _max_bytes == 0 || _byte_count + pack_size <= _max_bytes;
+}
+
+void transaction_pool::evict_for( uint32_t pack_size, uint64_t fee_per_kb, fc::time_point_sec now )
+{
+   FC_ASSERT( make_room( pack_size, fee_per_kb, now, true ),
+              "No room for a transaction of ${s} bytes paying ${f} per kilobyte", ("s", pack_size)("f", fee_per_kb) );
+}
+
+bool transaction_pool::make_room( uint32_t pack_size, uint64_t fee_per_kb, fc::time_point_sec now, bool evict )
+{
+   if( has_room( pack_size ) )
+      return true;
+   if( pack_size > _max_bytes )
+      return false;
+
+   const uint64_t needed = _byte_count + pack_size - _max_bytes;
+   uint64_t freed = 0;
+   vector<entry_index_type::index<by_arrival>::type::iterator> victims;
+
+   // expired transactions can no longer be included, then the ones paying the least go first
+   const auto& by_exp_idx = _entries.get<by_expiration>();
+   for( auto itr = by_exp_idx.begin(); freed < needed && itr != by_exp_idx.end() && itr->expiration < now; ++itr )
+   {
+      freed += itr->pack_size;
+      victims.push_back( _entries.project<by_arrival>( itr ) );
+   }
+   const auto& by_fee_idx = _entries.get<by_fee>();
+   for( auto itr = by_fee_idx.rbegin(); freed < needed && itr != by_fee_idx.rend() && itr->fee_per_kb < fee_per_kb;
+        ++itr )
+   {
+      if( itr->expiration < now )
+         continue;
+      freed += itr->pack_size;
+      victims.push_back( _entries.project<by_arrival>( std::prev( itr.base() ) ) );
+   }
+   if( freed < needed )
+      return false;
+
+   if( evict )
+   {
+      for( const auto& victim : victims )
+         erase( victim );
+      _evictions += victims.size();
+   }
+   return true;
+}
+
+void transaction_pool::erase( entry_index_type::index<by_arrival>::type::iterator itr )
+{
+   _byte_count -= itr->pack_size;
+   _entries.get<by_arrival>().erase( itr );
+}
+
+bool transaction_pool::contains( const transaction_id_type& id )const
+{
+   return _entries.get<by_id>().count( id ) > 0;
+}
+
+void transaction_pool::clear()
+{
+   _entries.clear();
+   _byte_count = 0;
+}
+
+vector<processed_transaction> transaction_pool::release()
+{
+   vector<processed_transaction> result;
+   result.reserve( _entries.size() );
+   auto& by_arrival_idx = _entries.get<by_arrival>();
+   // none of the keys is read from the transaction itself, so it can be moved out in place
+   for( auto itr = by_arrival_idx.begin(); itr != by_arrival_idx.end(); ++itr )
+      by_arrival_idx.modify( itr, [&]( entry& e ) { result.push_back( std::move( e.trx ) ); } );
+   clear();
+   return result;
+}
+
+vector<const transaction_pool::entry*> transaction_pool::by_priority()const
+{
+   vector<const entry*> result;
+   result.reserve( _entries.size() );
+   for( const entry& e : _entries.get<by_fee>() )
+      result.push_back( &e );
+   return result;
+}
+
+transaction_pool_statistics transaction_pool::get_statistics()const
+{
+   transaction_pool_statistics s;
+   s.transaction_count = _entries.size();
+   s.byte_count        = _byte_count;
+   s.max_bytes         = _max_bytes;
+   s.max_per_account   = _max_per_account;
+   s.evictions         = _evictions;
+   s.rejections        = _rejections;
+   return s;
+}
+
+} } // graphene::chain
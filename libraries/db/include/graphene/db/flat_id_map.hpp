@@ -0,0 +1,252 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/db/object_id.hpp>
+
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   namespace detail {
+      inline object_id_type&       slot_key( object_id_type& k )       { return k; }
+      inline const object_id_type& slot_key( const object_id_type& k ) { return k; }
+      template<typename T> object_id_type&       slot_key( std::pair<object_id_type,T>& p )       { return p.first; }
+      template<typename T> const object_id_type& slot_key( const std::pair<object_id_type,T>& p ) { return p.first; }
+
+      inline void reset_slot( object_id_type& k, uint64_t empty ) { k.number = empty; }
+      template<typename T> void reset_slot( std::pair<object_id_type,T>& p, uint64_t empty )
+      {
+         p.first.number = empty;
+         p.second = T();
+      }
+   }
+
+   /**
+    *  @class flat_id_table
+    *  @brief an open addressing hash table keyed by object_id_type
+    *
+    *  All slots live in a single vector and collisions are resolved by linear probing, so a lookup touches one or
+    *  two cache lines instead of chasing node pointers.  Erasing uses backward shift deletion, which keeps probe
+    *  sequences short without tombstones.  Iteration order is unspecified, and iterators are invalidated by any
+    *  insert or erase.
+    *
+    *  The id with every bit set is reserved to mark empty slots; it is not a valid id because there is no space 255.
+    */
+   template<typename Slot>
+   class flat_id_table
+   {
+      public:
+         static const uint64_t empty_key = uint64_t(-1);
+
+         flat_id_table() {}
+         flat_id_table( flat_id_table&& other ) { *this = std::move(other); }
+         flat_id_table& operator=( flat_id_table&& other )
+         {
+            _slots = std::move( other._slots );
+            _size  = other._size;
+            _shift = other._shift;
+            other.shrink();
+            return *this;
+         }
+
+         class const_iterator
+         {
+            public:
+               const_iterator( const Slot* pos, const Slot* end ):_pos(pos),_end(end) { skip_empty(); }
+
+               const Slot& operator*()const  { return *_pos; }
+               const Slot* operator->()const { return _pos; }
+               const_iterator& operator++()  { ++_pos; skip_empty(); return *this; }
+               bool operator==( const const_iterator& o )const { return _pos == o._pos; }
+               bool operator!=( const const_iterator& o )const { return _pos != o._pos; }
+
+            protected:
+               void skip_empty() { while( _pos != _end && detail::slot_key(*_pos).number == empty_key ) ++_pos; }
+               const Slot* _pos;
+               const Slot* _end;
+         };
+
+         class iterator : public const_iterator
+         {
+            public:
+               iterator( Slot* pos, Slot* end ):const_iterator(pos,end) {}
+
+               Slot& operator*()const  { return *const_cast<Slot*>(this->_pos); }
+               Slot* operator->()const { return const_cast<Slot*>(this->_pos); }
+               iterator& operator++()  { const_iterator::operator++(); return *this; }
+         };
+
+         iterator       begin()       { return iterator( _slots.data(), _slots.data() + _slots.size() ); }
+         iterator       end()         { return iterator( _slots.data() + _slots.size(), _slots.data() + _slots.size() ); }
+         const_iterator begin()const  { return const_iterator( _slots.data(), _slots.data() + _slots.size() ); }
+         const_iterator end()const    { return const_iterator( _slots.data() + _slots.size(), _slots.data() + _slots.size() ); }
+
+         size_t size()const     { return _size; }
+         bool   empty()const    { return _size == 0; }
+         size_t capacity()const { return _slots.size(); }
+
+         iterator find( object_id_type id )
+         {
+            Slot* s = lookup( id );
+            return s ? make_iterator( s ) : end();
+         }
+         const_iterator find( object_id_type id )const
+         {
+            const Slot* s = lookup_const( id );
+            return s ? const_iterator( s, _slots.data() + _slots.size() ) : end();
+         }
+         size_t count( object_id_type id )const { return lookup_const( id ) ? 1 : 0; }
+
+         size_t erase( object_id_type id )
+         {
+            Slot* s = lookup( id );
+            if( s == nullptr ) return 0;
+            erase_slot( size_t( s - _slots.data() ) );
+            return 1;
+         }
+         void erase( const const_iterator& itr ) { erase_slot( size_t( &*itr - _slots.data() ) ); }
+
+         /** removes every entry but keeps the allocated slots for reuse */
+         void clear()
+         {
+            if( _size == 0 ) return;
+            for( auto& s : _slots ) detail::reset_slot( s, empty_key );
+            _size = 0;
+         }
+
+         /** releases the allocated slots */
+         void shrink()
+         {
+            std::vector<Slot>().swap( _slots );
+            _size = 0;
+            _shift = 64;
+         }
+
+      protected:
+         /** @return the slot for id and whether it was newly inserted, a new slot only has its key set */
+         std::pair<Slot*,bool> insert_slot( object_id_type id )
+         {
+            if( (_size + 1) * 4 > _slots.size() * 3 )
+               grow();
+            const size_t mask = _slots.size() - 1;
+            for( size_t i = home( id ); ; i = (i + 1) & mask )
+            {
+               Slot& s = _slots[i];
+               if( detail::slot_key(s).number == empty_key )
+               {
+                  detail::slot_key(s) = id;
+                  ++_size;
+                  return std::make_pair( &s, true );
+               }
+               if( detail::slot_key(s) == id )
+                  return std::make_pair( &s, false );
+            }
+         }
+
+         Slot* lookup( object_id_type id )
+         {
+            if( _size == 0 ) return nullptr;
+            const size_t mask = _slots.size() - 1;
+            for( size_t i = home( id ); ; i = (i + 1) & mask )
+            {
+               Slot& s = _slots[i];
+               if( detail::slot_key(s) == id ) return &s;
+               if( detail::slot_key(s).number == empty_key ) return nullptr;
+            }
+         }
+         const Slot* lookup_const( object_id_type id )const { return const_cast<flat_id_table*>(this)->lookup( id ); }
+         iterator    make_iterator( Slot* s ) { return iterator( s, _slots.data() + _slots.size() ); }
+
+      private:
+         /** Fibonacci hashing, the instance bits that vary the most end up spread over the whole table */
+         size_t home( object_id_type id )const
+         {
+            return size_t( (id.number * 0x9E3779B97F4A7C15ull) >> _shift );
+         }
+
+         void grow()
+         {
+            std::vector<Slot> old;
+            old.swap( _slots );
+            const size_t new_capacity = old.empty() ? 16 : old.size() * 2;
+            _slots.resize( new_capacity );
+            for( auto& s : _slots ) detail::reset_slot( s, empty_key );
+            _shift = 64;
+            for( size_t c = new_capacity; c > 1; c >>= 1 ) --_shift;
+            _size = 0;
+            for( auto& s : old )
+               if( detail::slot_key(s).number != empty_key )
+                  *insert_slot( detail::slot_key(s) ).first = std::move(s);
+         }
+
+         void erase_slot( size_t i )
+         {
+            const size_t mask = _slots.size() - 1;
+            for( size_t j = (i + 1) & mask; detail::slot_key(_slots[j]).number != empty_key; j = (j + 1) & mask )
+            {
+               // move the entry at j back into the hole at i if i lies on its probe path
+               const size_t h = home( detail::slot_key(_slots[j]) );
+               if( ((j - h) & mask) >= ((j - i) & mask) )
+               {
+                  _slots[i] = std::move( _slots[j] );
+                  i = j;
+               }
+            }
+            detail::reset_slot( _slots[i], empty_key );
+            --_size;
+         }
+
+         std::vector<Slot> _slots;
+         size_t            _size  = 0;
+         unsigned          _shift = 64;
+   };
+
+   /**
+    *  @brief a flat_id_table that maps each id to a value of type T
+    */
+   template<typename T>
+   class flat_id_map : public flat_id_table< std::pair<object_id_type,T> >
+   {
+      public:
+         typedef flat_id_table< std::pair<object_id_type,T> > base_type;
+
+         T& operator[]( object_id_type id ) { return this->insert_slot( id ).first->second; }
+
+         /** inserts value only if id is not already present */
+         std::pair<typename base_type::iterator,bool> emplace( object_id_type id, T&& value )
+         {
+            auto r = this->insert_slot( id );
+            if( r.second ) r.first->second = std::move(value);
+            return std::make_pair( this->make_iterator( r.first ), r.second );
+         }
+   };
+
+   /**
+    *  @brief a flat_id_table holding only ids
+    */
+   class flat_id_set : public flat_id_table< object_id_type >
+   {
+      public:
+         bool insert( object_id_type id ) { return insert_slot( id ).second; }
+   };
+
+} } // graphene::db
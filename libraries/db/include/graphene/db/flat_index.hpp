@@ -20,16 +20,18 @@
  */
 #pragma once
 #include <graphene/db/index.hpp>
+#include <graphene/db/paged_slab.hpp>
 
 namespace graphene { namespace db {
 
    /**
     *  @class flat_index
-    *  @brief A flat index uses a vector<T> to store data
+    *  @brief A flat index uses a paged_slab<T> to store data
     *
     *  This index is preferred in situations where the data will never be
     *  removed from main memory and when lots of small objects that
-    *  are accessed in order are required.
+    *  are accessed in order are required.  Every slot below size() holds
+    *  an object unless it was removed, and objects never move once constructed.
     */
    template<typename T>
    class flat_index : public index
@@ -37,18 +39,18 @@ namespace graphene { namespace db {
       public:
          typedef T object_type;
 
-         virtual const object&  create( const std::function<void(object&)>& constructor ) override
+         virtual const object&  create( object_callback constructor ) override
          {
              auto id = get_next_id();
              auto instance = id.instance();
-             if( instance >= _objects.size() ) _objects.resize( instance + 1 );
-             _objects[instance].id = id;
-             constructor( _objects[instance] );
+             T& obj = slot( instance );
+             obj.id = id;
+             constructor( obj );
              use_next_id();
-             return _objects[instance];
+             return obj;
          }
 
-         virtual void modify( const object& obj, const std::function<void(object&)>& modify_callback ) override
+         virtual void modify( const object& obj, object_callback modify_callback ) override
          {
             assert( obj.id.instance() < _objects.size() );
             modify_callback( _objects[obj.id.instance()] );
@@ -58,16 +60,16 @@ namespace graphene { namespace db {
          {
             auto instance = obj.id.instance();
             assert( nullptr != dynamic_cast<T*>(&obj) );
-            if( _objects.size() <= instance ) _objects.resize( instance+1 );
-            _objects[instance] = std::move( static_cast<T&>(obj) );
-            return _objects[instance];
+            T& result = slot( instance );
+            result = std::move( static_cast<T&>(obj) );
+            return result;
          }
 
          virtual void remove( const object& obj ) override
          {
             assert( nullptr != dynamic_cast<const T*>(&obj) );
-            const auto instance = obj.id.instance();
-            _objects[instance] = T();
+            // the slot is emptied rather than reset to T(), so that neither lookups, iteration nor hash() see it
+            _objects.erase( obj.id.instance() );
          }
 
          virtual const object* find( object_id_type id )const override
@@ -75,25 +77,19 @@ namespace graphene { namespace db {
             assert( id.space() == T::space_id );
             assert( id.type() == T::type_id );
 
-            const auto instance = id.instance();
-            if( instance >= _objects.size() ) return nullptr;
-            return &_objects[instance];
+            return _objects.find( id.instance() );
          }
 
          virtual void inspect_all_objects(std::function<void (const object&)> inspector)const override
          {
             try {
-               for( const auto& ptr : _objects )
-               {
-                  inspector(ptr);
-               }
+               _objects.for_each( [&]( const T& o ) { inspector( o ); } );
             } FC_CAPTURE_AND_RETHROW()
          }
 
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
-            for( const auto& ptr : _objects )
-               result += ptr.hash();
+            _objects.for_each( [&]( const T& o ) { result += o.hash(); } );
 
             return result;
          }
@@ -101,29 +97,41 @@ namespace graphene { namespace db {
          class const_iterator
          {
             public:
-               const_iterator(){}
-               const_iterator( const typename vector<T>::const_iterator& a ):_itr(a){}
+               const_iterator( const typename paged_slab<T>::const_iterator& a ):_itr(a){}
                friend bool operator==( const const_iterator& a, const const_iterator& b ) { return a._itr == b._itr; }
                friend bool operator!=( const const_iterator& a, const const_iterator& b ) { return a._itr != b._itr; }
-               const T* operator*()const { return static_cast<const T*>(&*_itr); }
+               const T* operator*()const { return &*_itr; }
                const_iterator& operator++(int){ ++_itr; return *this; }
                const_iterator& operator++()   { ++_itr; return *this; }
             private:
-               typename vector<T>::const_iterator _itr;
+               typename paged_slab<T>::const_iterator _itr;
          };
          const_iterator begin()const { return const_iterator(_objects.begin()); }
          const_iterator end()const   { return const_iterator(_objects.end());   }
 
          size_t size()const{ return _objects.size(); }
+         size_t object_count()const { return _objects.count(); }
+         size_t approximate_bytes()const { return _objects.memory_used(); }
 
-         void resize( uint32_t s ) { 
-            _objects.resize(s); 
+         void resize( uint32_t s ) {
+            while( _objects.size() > s )
+               _objects.erase( _objects.size() - 1 );
             for( uint32_t i = 0; i < s; ++i )
-               _objects[i].id = object_id_type(object_type::space_id,object_type::type_id,i);
+               slot( i ).id = object_id_type(object_type::space_id,object_type::type_id,i);
          }
 
       private:
-         vector< T > _objects;
+         /** @return the object at instance, default constructing it and every slot above the current size below it */
+         T& slot( uint32_t instance )
+         {
+            for( size_t i = _objects.size(); i < instance; ++i )
+               _objects.emplace( i );
+            if( !_objects.contains( instance ) )
+               _objects.emplace( instance );
+            return _objects[instance];
+         }
+
+         paged_slab< T > _objects;
    };
 
 } } // graphene::db
@@ -24,6 +24,7 @@
 #include <boost/multi_index/member.hpp>
 #include <boost/multi_index/ordered_index.hpp>
 #include <boost/multi_index/mem_fun.hpp>
+#include <boost/mpl/size.hpp>
 
 namespace graphene { namespace chain {
 
@@ -51,7 +52,7 @@ namespace graphene { namespace chain {
             return *insert_result.first;
          }
 
-         virtual const object&  create(const std::function<void(object&)>& constructor )override
+         virtual const object&  create( object_callback constructor )override
          {
             ObjectType item;
             item.id = get_next_id();
@@ -62,7 +63,7 @@ namespace graphene { namespace chain {
             return *insert_result.first;
          }
 
-         virtual void modify( const object& obj, const std::function<void(object&)>& m )override
+         virtual void modify( const object& obj, object_callback m )override
          {
             assert( nullptr != dynamic_cast<const ObjectType*>(&obj) );
             auto ok = _indices.modify( _indices.iterator_to( static_cast<const ObjectType&>(obj) ),
@@ -92,6 +93,18 @@ namespace graphene { namespace chain {
 
          const index_type& indices()const { return _indices; }
 
+         size_t object_count()const { return _indices.size(); }
+
+         /**
+          *  Each element is a separately allocated node holding the object and, for every index of the
+          *  container, a header of about three pointers.  Allocator overhead is estimated at two words.
+          */
+         size_t approximate_bytes()const
+         {
+            const size_t index_count = boost::mpl::size<typename index_type::index_specifier_type_list>::value;
+            return _indices.size() * ( sizeof(ObjectType) + ( 3 * index_count + 2 ) * sizeof(void*) );
+         }
+
          virtual fc::uint128 hash()const override {
             fc::uint128 result;
             for( const auto& ptr : _indices )
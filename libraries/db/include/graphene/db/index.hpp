@@ -31,6 +31,51 @@ namespace graphene { namespace db {
    class object_database;
    using fc::path;
 
+   /**
+    *  @brief header written at the start of every index file by primary_index::save()
+    *
+    *  The header is followed by object_count + 1 uint64_t offsets (relative to the end of the table)
+    *  and then by the packed objects.  The offset table lets open() unpack every object in place
+    *  from the memory mapped file without first copying it into a buffer of its own.
+    */
+   struct index_file_header
+   {
+      static const uint32_t current_magic   = 0x44495047; ///< "GPID"
+      static const uint32_t current_version = 1;
+
+      uint32_t       magic          = current_magic;
+      uint32_t       format_version = current_version;
+      object_id_type next_id;
+      fc::sha256     object_version;
+      uint64_t       object_count   = 0;
+   };
+
+   /**
+    *  @brief a point in time summary of the size of a primary_index and the activity it has seen
+    *
+    *  The activity counters accumulate from the time the index was created, so rates are found by
+    *  comparing two samples.
+    */
+   struct index_statistics
+   {
+      uint8_t     space_id = 0;
+      uint8_t     type_id  = 0;
+      std::string object_type;
+      uint64_t    object_count      = 0;
+      uint64_t    approximate_bytes = 0; ///< objects plus container overhead, excluding memory owned by the objects
+      uint64_t    creates  = 0;
+      uint64_t    modifies = 0;
+      uint64_t    removes  = 0;
+      uint64_t    undo_bytes = 0;        ///< bytes of packed pre-images saved to the undo history before modifications
+   };
+} } // graphene::db
+
+FC_REFLECT( graphene::db::index_file_header, (magic)(format_version)(next_id)(object_version)(object_count) )
+FC_REFLECT( graphene::db::index_statistics,
+            (space_id)(type_id)(object_type)(object_count)(approximate_bytes)(creates)(modifies)(removes)(undo_bytes) )
+
+namespace graphene { namespace db {
+
    /**
     * @class index_observer
     * @brief used to get callbacks when objects change
@@ -47,6 +92,28 @@ namespace graphene { namespace db {
          virtual void on_modify( const object& obj ){}
    };
 
+   /**
+    *  @class object_callback
+    *  @brief a non-owning reference to a callable with the signature void(object&)
+    *
+    *  The create and modify interfaces of index take their callbacks as object_callback rather than std::function,
+    *  so passing a lambda never allocates and calling it is a single indirect call.  The referenced callable must
+    *  outlive the call it is passed to, which is always the case for a temporary passed as an argument.
+    */
+   class object_callback
+   {
+      public:
+         template<typename Callable>
+         object_callback( const Callable& c )
+         :_callable( &c ),_invoke( []( const void* c, object& o ){ (*static_cast<const Callable*>(c))( o ); } ){}
+
+         void operator()( object& o )const { _invoke( _callable, o ); }
+
+      private:
+         const void* _callable;
+         void     (*_invoke)( const void*, object& );
+   };
+
    /**
     *  @class index
     *  @brief abstract base class for accessing objects indexed in various ways.
@@ -86,7 +153,7 @@ namespace graphene { namespace db {
           * Builds a new object and assigns it the next available ID and then
           * initializes it with constructor and lastly inserts it into the index.
           */
-         virtual const object&  create( const std::function<void(object&)>& constructor ) = 0;
+         virtual const object&  create( object_callback constructor ) = 0;
 
          /**
           *  Opens the index loading objects from a file
@@ -110,7 +177,7 @@ namespace graphene { namespace db {
             return *maybe_found;
          }
 
-         virtual void               modify( const object& obj, const std::function<void(object&)>& ) = 0;
+         virtual void               modify( const object& obj, object_callback m ) = 0;
          virtual void               remove( const object& obj ) = 0;
 
          /**
@@ -121,13 +188,33 @@ namespace graphene { namespace db {
           */
          template<typename Object, typename Lambda>
          void modify( const Object& obj, const Lambda& l ) {
-            modify( static_cast<const object&>(obj), std::function<void(object&)>( [&]( object& o ){ l( static_cast<Object&>(o) ); } ) );
+            auto wrapper = [&l]( object& o ){ l( static_cast<Object&>(o) ); };
+            modify( static_cast<const object&>(obj), object_callback( wrapper ) );
          }
 
          virtual void               inspect_all_objects(std::function<void(const object&)> inspector)const = 0;
          virtual fc::uint128        hash()const = 0;
+         virtual index_statistics   get_statistics()const = 0;
+
+         /**
+          *  Starts (or stops) maintaining digest() as objects are created, modified and removed.  Enabling
+          *  computes the digest from scratch with hash() once, after which each change costs two object hashes.
+          */
+         virtual void               enable_digest( bool enable ) = 0;
+         virtual bool               digest_enabled()const = 0;
+         /** @return the same value as hash(), maintained incrementally while enabled */
+         virtual fc::uint128        digest()const = 0;
          virtual void               add_observer( const shared_ptr<index_observer>& ) = 0;
 
+         /**
+          *  While deferred, secondary indexes are not told about changes to this index.  They must be brought
+          *  up to date with rebuild_secondary_indexes() before they are used again.
+          */
+         virtual void               defer_secondary_indexes( bool defer ) = 0;
+         virtual bool               has_secondary_indexes()const = 0;
+         /** Rebuilds every secondary index from the objects currently in this index */
+         virtual void               rebuild_secondary_indexes() = 0;
+
    };
 
    class secondary_index
@@ -138,6 +225,20 @@ namespace graphene { namespace db {
          virtual void object_removed( const object& obj ){};
          virtual void about_to_modify( const object& before ){};
          virtual void object_modified( const object& after  ){};
+
+         /** discards everything that has been indexed */
+         virtual void clear() = 0;
+
+         /**
+          *  Replaces the contents of this index with the entries for every object in primary.  Indexes
+          *  that can build their containers faster from sorted input than by repeated insertion should
+          *  override this.
+          */
+         virtual void rebuild( const index& primary )
+         {
+            clear();
+            primary.inspect_all_objects( [this]( const object& o ) { object_inserted( o ); } );
+         }
    };
 
    /**
@@ -178,8 +279,16 @@ namespace graphene { namespace db {
          }
 
       protected:
+         bool secondary_indexes_active()const { return !_sindex_deferred; }
+
          vector< shared_ptr<index_observer> >   _observers;
          vector< unique_ptr<secondary_index> >  _sindex;
+         bool                                   _sindex_deferred = false;
+
+         uint64_t                               _creates    = 0;
+         uint64_t                               _modifies   = 0;
+         uint64_t                               _removes    = 0;
+         uint64_t                               _undo_bytes = 0;
 
       private:
          object_database& _db;
@@ -223,72 +332,143 @@ namespace graphene { namespace db {
             if( !fc::exists( db ) ) return;
             fc::file_mapping fm( db.generic_string().c_str(), fc::read_only );
             fc::mapped_region mr( fm, fc::read_only, 0, fc::file_size(db) );
-            fc::datastream<const char*> ds( (const char*)mr.get_address(), mr.get_size() );
-            fc::sha256 open_ver;
-
-            fc::raw::unpack(ds, _next_id);
-            fc::raw::unpack(ds, open_ver);
-            FC_ASSERT( open_ver == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
-            try {
-               vector<char> tmp;
-               while( true ) 
-               {
-                  fc::raw::unpack( ds, tmp );
-                  load( tmp );
-               }
-            } catch ( const fc::exception&  ){}
+            const char* begin = (const char*)mr.get_address();
+            fc::datastream<const char*> ds( begin, mr.get_size() );
+
+            index_file_header header;
+            fc::raw::unpack( ds, header );
+            FC_ASSERT( header.magic == index_file_header::current_magic &&
+                       header.format_version == index_file_header::current_version,
+                       "Unrecognized index file format, the object database must be rebuilt", ("file",db)("format",header.format_version) );
+            FC_ASSERT( header.object_version == get_object_version(), "Incompatible Version, the serialization of objects in this index has changed" );
+
+            const size_t table_size = (header.object_count + 1) * sizeof(uint64_t);
+            FC_ASSERT( size_t(ds.remaining()) >= table_size, "Truncated index file", ("file",db)("object_count",header.object_count) );
+            const char*  table     = begin + ds.tellp();
+            const char*  data      = table + table_size;
+            const size_t data_size = ds.remaining() - table_size;
+            auto offset_of = [table]( uint64_t i ) -> uint64_t {
+               uint64_t offset;
+               memcpy( &offset, table + i * sizeof(uint64_t), sizeof(offset) );
+               return offset;
+            };
+
+            uint64_t start = offset_of( 0 );
+            for( uint64_t i = 0; i < header.object_count; ++i )
+            {
+               const uint64_t end = offset_of( i + 1 );
+               FC_ASSERT( start <= end && end <= data_size, "Corrupt offset table", ("file",db)("object",i) );
+               fc::datastream<const char*> obj_ds( data + start, end - start );
+               object_type obj;
+               fc::raw::unpack( obj_ds, obj );
+               load_object( std::move(obj) );
+               start = end;
+            }
+            _next_id = header.next_id;
          }
 
          virtual void save( const path& db ) override 
          {
+            index_file_header header;
+            header.next_id        = _next_id;
+            header.object_version = get_object_version();
+            this->inspect_all_objects( [&]( const object& ) { ++header.object_count; } );
+
             std::ofstream out( db.generic_string(), 
                                std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
             FC_ASSERT( out );
-            auto ver  = get_object_version();
-            fc::raw::pack( out, _next_id );
-            fc::raw::pack( out, ver );
+            fc::raw::pack( out, header );
+
+            // reserve space for the offset table, it is filled in once the objects are written
+            std::vector<uint64_t> offsets( header.object_count + 1 );
+            const auto table_pos = out.tellp();
+            out.seekp( table_pos + std::streamoff( offsets.size() * sizeof(uint64_t) ) );
+
+            uint64_t i = 0;
+            uint64_t offset = 0;
             this->inspect_all_objects( [&]( const object& o ) {
                 auto vec = fc::raw::pack( static_cast<const object_type&>(o) );
-                auto packed_vec = fc::raw::pack( vec );
-                out.write( packed_vec.data(), packed_vec.size() );
+                offsets[i++] = offset;
+                out.write( vec.data(), vec.size() );
+                offset += vec.size();
             });
+            offsets[i] = offset;
+
+            out.seekp( table_pos );
+            out.write( (const char*)offsets.data(), offsets.size() * sizeof(uint64_t) );
+            FC_ASSERT( out, "Error writing index file", ("file",db) );
          }
 
          virtual const object&  load( const std::vector<char>& data )override
          {
-            const auto& result = DerivedIndex::insert( fc::raw::unpack<object_type>( data ) );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
+            return load_object( fc::raw::unpack<object_type>( data ) );
+         }
+
+         const object& load_object( object_type&& obj )
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            if( secondary_indexes_active() )
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
+            if( _digest_enabled ) _digest += result.hash();
             return result;
          }
 
+         /** Inserts an object that was previously removed, e.g. when the removal is undone */
+         virtual const object& insert( object&& obj )override
+         {
+            const auto& result = DerivedIndex::insert( std::move(obj) );
+            if( secondary_indexes_active() )
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
+            if( _digest_enabled ) _digest += result.hash();
+            return result;
+         }
 
-         virtual const object&  create(const std::function<void(object&)>& constructor )override
+
+         virtual const object&  create( object_callback constructor )override
          {
             const auto& result = DerivedIndex::create( constructor );
-            for( const auto& item : _sindex )
-               item->object_inserted( result );
+            ++_creates;
+            if( secondary_indexes_active() )
+               for( const auto& item : _sindex )
+                  item->object_inserted( result );
+            if( _digest_enabled ) _digest += result.hash();
             on_add( result );
             return result;
          }
 
          virtual void  remove( const object& obj ) override
          {
-            for( const auto& item : _sindex )
-               item->object_removed( obj );
+            ++_removes;
+            if( secondary_indexes_active() )
+               for( const auto& item : _sindex )
+                  item->object_removed( obj );
+            if( _digest_enabled ) _digest -= obj.hash();
             on_remove(obj);
             DerivedIndex::remove(obj);
          }
 
-         virtual void modify( const object& obj, const std::function<void(object&)>& m )override
+         /**
+          *  The call through index::modify is the only virtual one, DerivedIndex::modify is called directly and the
+          *  callback is invoked through object_callback without allocating.  Object types do not know the type of
+          *  their index, so object_database::modify cannot skip that one virtual call.
+          */
+         virtual void modify( const object& obj, object_callback m )override
          {
+            ++_modifies;
             save_undo( obj );
-            for( const auto& item : _sindex )
-               item->about_to_modify( obj );
+            if( _digest_enabled ) _digest -= obj.hash();
+            if( secondary_indexes_active() )
+               for( const auto& item : _sindex )
+                  item->about_to_modify( obj );
             DerivedIndex::modify( obj, m );
-            for( const auto& item : _sindex )
-               item->object_modified( obj );
-            on_modify( obj );
+            if( secondary_indexes_active() )
+               for( const auto& item : _sindex )
+                  item->object_modified( obj );
+            if( _digest_enabled ) _digest += obj.hash();
+            if( !_observers.empty() )
+               on_modify( obj );
          }
 
          virtual void add_observer( const shared_ptr<index_observer>& o ) override
@@ -296,8 +476,41 @@ namespace graphene { namespace db {
             _observers.emplace_back( o );
          }
 
+         virtual index_statistics get_statistics()const override
+         {
+            index_statistics stats;
+            stats.space_id          = object_type::space_id;
+            stats.type_id           = object_type::type_id;
+            stats.object_type       = fc::get_typename<object_type>::name();
+            stats.object_count      = DerivedIndex::object_count();
+            stats.approximate_bytes = DerivedIndex::approximate_bytes();
+            stats.creates           = _creates;
+            stats.modifies          = _modifies;
+            stats.removes           = _removes;
+            stats.undo_bytes        = _undo_bytes;
+            return stats;
+         }
+
+         virtual void enable_digest( bool enable )override
+         {
+            _digest_enabled = enable;
+            _digest = enable ? DerivedIndex::hash() : fc::uint128();
+         }
+         virtual bool        digest_enabled()const override { return _digest_enabled; }
+         virtual fc::uint128 digest()const override         { return _digest;         }
+
+         virtual void defer_secondary_indexes( bool defer )override { _sindex_deferred = defer;   }
+         virtual bool has_secondary_indexes()const override         { return !_sindex.empty(); }
+         virtual void rebuild_secondary_indexes()override
+         {
+            for( const auto& item : _sindex )
+               item->rebuild( *this );
+         }
+
       private:
          object_id_type _next_id;
+         bool           _digest_enabled = false;
+         fc::uint128    _digest;
    };
 
 } } // graphene::db
@@ -72,6 +72,12 @@ namespace graphene { namespace db {
          virtual void               move_from( object& obj ) = 0;
          virtual variant            to_variant()const  = 0;
          virtual vector<char>       pack()const = 0;
+         /** @return the number of bytes pack() produces */
+         virtual size_t             packed_size()const = 0;
+         /** serializes this object into the packed_size() bytes starting at data */
+         virtual void               pack_to( char* data, size_t size )const = 0;
+         /** replaces the value of this object with one previously serialized by pack() */
+         virtual void               unpack_from( const char* data, size_t size ) = 0;
          virtual fc::uint128        hash()const = 0;
    };
 
@@ -97,6 +103,20 @@ namespace graphene { namespace db {
          }
          virtual variant to_variant()const { return variant( static_cast<const DerivedClass&>(*this) ); }
          virtual vector<char> pack()const  { return fc::raw::pack( static_cast<const DerivedClass&>(*this) ); }
+         virtual size_t  packed_size()const { return fc::raw::pack_size( static_cast<const DerivedClass&>(*this) ); }
+         virtual void    pack_to( char* data, size_t size )const
+         {
+            fc::datastream<char*> ds( data, size );
+            fc::raw::pack( ds, static_cast<const DerivedClass&>(*this) );
+         }
+         virtual void    unpack_from( const char* data, size_t size )
+         {
+            // unpack into a fresh value, fc::raw::unpack does not clear containers it unpacks into
+            fc::datastream<const char*> ds( data, size );
+            DerivedClass tmp;
+            fc::raw::unpack( ds, tmp );
+            static_cast<DerivedClass&>(*this) = std::move( tmp );
+         }
          virtual fc::uint128  hash()const  {  
              auto tmp = this->pack();
              return fc::city_hash_crc_128( tmp.data(), tmp.size() );
@@ -21,11 +21,18 @@
 #pragma once
 #include <graphene/db/object.hpp>
 #include <graphene/db/index.hpp>
+#include <graphene/db/object_read_view.hpp>
 #include <graphene/db/undo_database.hpp>
 
 #include <fc/log/logger.hpp>
+#include <fc/thread/future.hpp>
 
+#include <atomic>
 #include <map>
+#include <memory>
+#include <unordered_set>
+
+namespace fc { class thread; }
 
 namespace graphene { namespace db {
 
@@ -39,14 +46,70 @@ namespace graphene { namespace db {
          object_database();
          ~object_database();
 
-         void reset_indexes() { _index.clear(); _index.resize(255); }
+         void reset_indexes() { _index.clear(); _index.resize(255); _digest_indexes.clear(); }
 
          void open(const fc::path& data_dir );
 
          /**
           * Saves the complete state of the object_database to disk, this could take a while
+          *
+          * The new files are written next to the current ones and moved into place once complete, after which
+          * any checkpoints written since the previous flush are discarded.
           */
          void flush();
+
+         /**
+          *  Writes every index to its own file under dir, in the format flush() uses.  Unlike flush() nothing in
+          *  the data directory is touched, so this can be used to export the state at a consistent point.
+          */
+         void save_snapshot( const fc::path& dir );
+         /**
+          *  Opens the database in data_dir with the indexes saved to snapshot_dir by save_snapshot(), and flushes
+          *  them into data_dir.  Anything already in data_dir must have been wiped.
+          */
+         void open_from_snapshot( const fc::path& data_dir, const fc::path& snapshot_dir );
+
+         /**
+          *  Starts (or stops) recording the IDs of objects that are created, modified or removed so that they
+          *  can be saved by write_checkpoint().  This should be enabled before open() so that no change made
+          *  after the last flush() is missed.
+          */
+         void enable_checkpoints( bool enable ) { _track_changes = enable; if( !enable ) _changed_objects.clear(); }
+         bool checkpoints_enabled()const { return _track_changes; }
+
+         /**
+          *  Writes every object changed since the last flush() or checkpoint to a new delta file.  open()
+          *  applies the deltas in order on top of the last full flush(), so a checkpoint costs time proportional
+          *  to the number of changed objects rather than to the size of the database.
+          */
+         void write_checkpoint();
+         /** @return the number of checkpoints written since the last flush() */
+         uint32_t checkpoint_count()const { return _checkpoint_count; }
+         /**
+          *  Merges the checkpoints written so far into one file on a background thread, keeping only the latest
+          *  value of every object, so that neither the disk space nor the time open() spends applying them grows
+          *  with every checkpoint.  Unlike flush() this does not save the objects themselves, so it does not hold up
+          *  the calling thread.  A merge that is still running is waited for first.
+          */
+         void merge_checkpoints();
+         /** waits for the merge started by merge_checkpoints(), if any; a merge that failed is only logged */
+         void wait_for_checkpoint_merge();
+
+         /**
+          *  Starts (or stops) recording the IDs of objects changed since the last read view was published.  The
+          *  first call to publish_read_view() after enabling copies every object.
+          */
+         void enable_read_views( bool enable );
+         bool read_views_enabled()const { return _track_view_changes; }
+
+         /**
+          *  Publishes a new object_read_view holding the current value of every object.  This must be called from
+          *  the thread that modifies the database, at a point where its state is consistent (e.g. between blocks).
+          */
+         void publish_read_view( uint64_t version );
+
+         /** @return the most recently published read view, or an empty pointer.  May be called from any thread. */
+         std::shared_ptr<const object_read_view> get_read_view()const { return std::atomic_load( &_read_view ); }
          void wipe(const fc::path& data_dir); // remove from disk
          void close();
 
@@ -81,7 +144,11 @@ namespace graphene { namespace db {
          /// in order to maintain proper undo history.
          ///@{
 
-         const object& insert( object&& obj ) { return get_mutable_index(obj.id).insert( std::move(obj) ); }
+         const object& insert( object&& obj )
+         {
+            record_change( obj.id );
+            return get_mutable_index(obj.id).insert( std::move(obj) );
+         }
          void          remove( const object& obj ) { get_mutable_index(obj.id).remove( obj ); }
          template<typename T, typename Lambda>
          void modify( const T& obj, const Lambda& m ) {
@@ -138,6 +205,55 @@ namespace graphene { namespace db {
 
          void pop_undo();
 
+         /**
+          *  Stops maintaining secondary indexes until end_bulk_load(), which rebuilds each of them in a single pass
+          *  with the indexes of different types built in parallel.  This is much faster than updating them object
+          *  by object while a large number of objects are loaded or replayed, but the secondary indexes must not be
+          *  used in between.  open() does this itself unless a bulk load is already in progress.
+          */
+         void begin_bulk_load();
+         void end_bulk_load();
+         bool in_bulk_load()const { return _bulk_load; }
+
+         /**
+          *  Begins a bulk load unless one is already in progress, and ends the one it began when complete() is
+          *  called or, if loading throws before that, when it is destroyed, so that the indexes never stay in
+          *  bulk mode.
+          */
+         class bulk_load_guard
+         {
+            public:
+               explicit bulk_load_guard( object_database& db );
+               ~bulk_load_guard();
+
+               /** ends the bulk load begun by this guard, rethrowing any error rebuilding the secondary indexes */
+               void complete();
+
+            private:
+               object_database& _db;
+               bool             _active;
+         };
+
+         /** @return the size and activity counters of every index, in order of space and type */
+         vector<index_statistics> get_index_statistics()const;
+
+         /**
+          *  Selects every index registered so far as part of the state digest.  Indexes added afterwards, such as
+          *  those of plugins which differ from node to node, are left out.
+          */
+         void select_state_digest_indexes();
+         /**
+          *  Starts (or stops) maintaining the digest of every selected index.  Enabling hashes every object once,
+          *  so this is best done before open().
+          */
+         void enable_state_digest( bool enable );
+         bool state_digest_enabled()const { return _track_digest; }
+         /**
+          *  @return a digest of the current value of every object in the selected indexes, which is equal on two
+          *  nodes exactly when their states are equal.  Costs one hash per index, not per object.
+          */
+         fc::sha256 get_state_digest()const;
+
          fc::path get_data_dir()const { return _data_dir; }
 
          /** public for testing purposes only... should be private in practice. */
@@ -157,12 +273,36 @@ namespace graphene { namespace db {
 
          friend class base_primary_index;
          friend class undo_database;
-         void save_undo( const object& obj );
+         size_t save_undo( const object& obj );
          void save_undo_add( const object& obj );
          void save_undo_remove( const object& obj );
 
+         void save_indexes( const fc::path& dir );
+         void open_indexes( const fc::path& dir );
+         void load_checkpoints();
+
+         void record_change( object_id_type id )
+         {
+            if( _track_changes ) _changed_objects.insert( id );
+            if( _track_view_changes ) _view_changes.insert( id );
+         }
+
          fc::path                                                  _data_dir;
          vector< vector< unique_ptr<index> > >                     _index;
+
+         bool                                                      _track_changes = false;
+         std::unordered_set<object_id_type>                        _changed_objects;
+         uint32_t                                                  _checkpoint_sequence = 0;
+         uint32_t                                                  _checkpoint_count = 0;
+         std::shared_ptr<fc::thread>                               _checkpoint_thread;
+         fc::future<void>                                          _checkpoint_merge;
+
+         bool                                                      _track_view_changes = false;
+         bool                                                      _track_digest = false;
+         bool                                                      _bulk_load = false;
+         vector<index*>                                            _digest_indexes;
+         flat_id_set                                               _view_changes;
+         std::shared_ptr<const object_read_view>                   _read_view;
    };
 
 } } // graphene::db
@@ -0,0 +1,83 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <graphene/db/object.hpp>
+
+#include <array>
+#include <memory>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   /**
+    *  @class object_read_view
+    *  @brief an immutable copy of every object in an object_database as of one point in time
+    *
+    *  Views are published by object_database::publish_read_view(), usually once per block, and may be read from any
+    *  thread without locking while the database goes on to modify its own objects.  Consecutive views share every page
+    *  of objects that did not change between them, so publishing a view costs time and memory proportional to the
+    *  number of changed objects.
+    *
+    *  Only lookups by id are supported, the secondary indexes of the database are not part of the view.
+    */
+   class object_read_view
+   {
+      public:
+         static const uint32_t page_size = 256;
+
+         typedef std::shared_ptr<const object>          object_ptr;
+         typedef std::array<object_ptr, page_size>      page;
+         typedef std::vector< std::shared_ptr<page> >   index_pages;
+
+         /** the version passed to object_database::publish_read_view() */
+         uint64_t version()const { return _version; }
+
+         /** @return the object with id or nullptr if it did not exist when the view was published */
+         const object* find( object_id_type id )const
+         {
+            if( id.space() >= _indexes.size() ) return nullptr;
+            const auto& space = _indexes[id.space()];
+            if( id.type() >= space.size() || !space[id.type()] ) return nullptr;
+            const index_pages& pages = *space[id.type()];
+            const uint64_t page_num = id.instance() / page_size;
+            if( page_num >= pages.size() || !pages[page_num] ) return nullptr;
+            return (*pages[page_num])[id.instance() % page_size].get();
+         }
+
+         template<typename T>
+         const T* find( object_id_type id )const
+         {
+            const object* obj = find( id );
+            assert( !obj || nullptr != dynamic_cast<const T*>(obj) );
+            return static_cast<const T*>(obj);
+         }
+
+         template<uint8_t SpaceID, uint8_t TypeID, typename T>
+         const T* find( object_id<SpaceID,TypeID,T> id )const { return find<T>(id); }
+
+      private:
+         friend class object_database;
+
+         uint64_t                                                     _version = 0;
+         std::vector< std::vector< std::shared_ptr<index_pages> > >   _indexes;
+   };
+
+} } // graphene::db
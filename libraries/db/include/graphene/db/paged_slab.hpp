@@ -0,0 +1,220 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#pragma once
+#include <bitset>
+#include <cassert>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace graphene { namespace db {
+
+   namespace detail {
+      constexpr size_t floor_pow2( size_t n, size_t p = 1 ) { return p * 2 > n ? p : floor_pow2( n, p * 2 ); }
+      constexpr size_t log2_pow2( size_t n ) { return n <= 1 ? 0 : 1 + log2_pow2( n / 2 ); }
+   }
+
+   /**
+    *  @class paged_slab
+    *  @brief a sparse array of T stored in fixed size pages that are never relocated
+    *
+    *  Slot i lives in page i / page_size, so lookup by instance is two indexed loads, and growing the slab only
+    *  appends page pointers, so references to stored elements remain valid until the element itself is erased.
+    *  A page is allocated the first time one of its slots is filled and released once all of its slots are empty,
+    *  which costs one allocation per page_size objects instead of one per object.
+    *
+    *  Pages are sized to about 16KB, but never hold more than 1024 objects.
+    */
+   template<typename T>
+   class paged_slab
+   {
+      public:
+         static const size_t page_size  = detail::floor_pow2( sizeof(T) >= 16384 ? 1 :
+                                                              ( 16384 / sizeof(T) > 1024 ? 1024 : 16384 / sizeof(T) ) );
+         static const size_t page_shift = detail::log2_pow2( page_size );
+         static const size_t page_mask  = page_size - 1;
+
+      private:
+         struct page
+         {
+            page() {}
+            ~page()
+            {
+               for( size_t i = 0; count > 0 && i < page_size; ++i )
+                  if( live[i] )
+                  {
+                     at(i).~T();
+                     --count;
+                  }
+            }
+            page( const page& ) = delete;
+            page& operator=( const page& ) = delete;
+
+            T&       at( size_t i )      { return *reinterpret_cast<T*>( &slots[i] ); }
+            const T& at( size_t i )const { return *reinterpret_cast<const T*>( &slots[i] ); }
+
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type slots[page_size];
+            std::bitset<page_size>                                     live;
+            size_t                                                     count = 0;
+         };
+
+      public:
+         paged_slab() {}
+         paged_slab( const paged_slab& ) = delete;
+         paged_slab& operator=( const paged_slab& ) = delete;
+
+         /** @return one past the highest occupied slot */
+         size_t size()const  { return _size; }
+         bool   empty()const { return _size == 0; }
+         /** @return the number of occupied slots */
+         size_t count()const { return _count; }
+         /** @return the bytes held by allocated pages and the page table */
+         size_t memory_used()const
+         {
+            size_t pages = 0;
+            for( const auto& pg : _pages ) if( pg ) ++pages;
+            return pages * sizeof(page) + _pages.capacity() * sizeof(_pages[0]);
+         }
+
+         bool contains( size_t i )const
+         {
+            const auto p = i >> page_shift;
+            return p < _pages.size() && _pages[p] && _pages[p]->live[i & page_mask];
+         }
+
+         T*       find( size_t i )       { return contains(i) ? &_pages[i >> page_shift]->at( i & page_mask ) : nullptr; }
+         const T* find( size_t i )const  { return contains(i) ? &_pages[i >> page_shift]->at( i & page_mask ) : nullptr; }
+
+         /** @pre contains(i) */
+         T&       operator[]( size_t i )      { return _pages[i >> page_shift]->at( i & page_mask ); }
+         const T& operator[]( size_t i )const { return _pages[i >> page_shift]->at( i & page_mask ); }
+
+         /** Constructs a T in slot i, which must be empty */
+         template<typename... Args>
+         T& emplace( size_t i, Args&&... args )
+         {
+            const auto p = i >> page_shift;
+            if( p >= _pages.size() ) _pages.resize( p + 1 );
+            if( !_pages[p] ) _pages[p].reset( new page );
+            page& pg = *_pages[p];
+            const auto s = i & page_mask;
+            assert( !pg.live[s] );
+            T* result = new( &pg.slots[s] ) T( std::forward<Args>(args)... );
+            pg.live[s] = true;
+            ++pg.count;
+            ++_count;
+            if( i >= _size ) _size = i + 1;
+            return *result;
+         }
+
+         /** Destroys the T in slot i, if any, and releases its page once it is empty */
+         void erase( size_t i )
+         {
+            if( !contains(i) ) return;
+            const auto p = i >> page_shift;
+            page& pg = *_pages[p];
+            const auto s = i & page_mask;
+            pg.at(s).~T();
+            pg.live[s] = false;
+            --_count;
+            if( --pg.count == 0 ) _pages[p].reset();
+
+            if( i + 1 == _size )
+            {
+               while( _size > 0 && !contains( _size - 1 ) ) --_size;
+               _pages.resize( (_size + page_mask) >> page_shift );
+            }
+         }
+
+         void clear()
+         {
+            _pages.clear();
+            _size  = 0;
+            _count = 0;
+         }
+
+         /** Iterates the occupied slots in order of instance */
+         class const_iterator
+         {
+            public:
+               typedef std::forward_iterator_tag iterator_category;
+               typedef T                         value_type;
+               typedef std::ptrdiff_t            difference_type;
+               typedef const T*                  pointer;
+               typedef const T&                  reference;
+
+               const_iterator( const paged_slab* s, size_t i ):_slab(s),_index(i) { skip_empty(); }
+
+               const T& operator*()const  { return (*_slab)[_index]; }
+               const T* operator->()const { return &(*_slab)[_index]; }
+               const_iterator& operator++()    { ++_index; skip_empty(); return *this; }
+               const_iterator  operator++(int) { const_iterator result( *this ); ++(*this); return result; }
+               bool operator==( const const_iterator& o )const { return _index == o._index; }
+               bool operator!=( const const_iterator& o )const { return _index != o._index; }
+
+            private:
+               void skip_empty()
+               {
+                  while( _index < _slab->_size )
+                  {
+                     const auto& pg = _slab->_pages[_index >> page_shift];
+                     if( !pg )
+                        _index = ( (_index >> page_shift) + 1 ) << page_shift;
+                     else if( !pg->live[_index & page_mask] )
+                        ++_index;
+                     else
+                        break;
+                  }
+                  if( _index > _slab->_size ) _index = _slab->_size;
+               }
+
+               const paged_slab* _slab;
+               size_t            _index;
+         };
+
+         const_iterator begin()const { return const_iterator( this, 0 ); }
+         const_iterator end()const   { return const_iterator( this, _size ); }
+
+         /** Calls f on every stored element in order of instance, one page at a time */
+         template<typename Functor>
+         void for_each( Functor&& f )const
+         {
+            for( const auto& pg : _pages )
+            {
+               if( !pg ) continue;
+               for( size_t s = 0, seen = 0; seen < pg->count; ++s )
+                  if( pg->live[s] )
+                  {
+                     ++seen;
+                     f( pg->at(s) );
+                  }
+            }
+         }
+
+      private:
+         std::vector< std::unique_ptr<page> > _pages;
+         size_t                               _size  = 0;
+         size_t                               _count = 0;
+   };
+
+} } // graphene::db
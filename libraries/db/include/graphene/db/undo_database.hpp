@@ -20,6 +20,7 @@
  */
 #pragma once
 #include <graphene/db/object.hpp>
+#include <graphene/db/flat_id_map.hpp>
 #include <deque>
 #include <fc/exception/exception.hpp>
 
@@ -29,12 +30,104 @@ namespace graphene { namespace db {
    using fc::flat_set;
    class object_database;
 
+   /**
+    *  @brief bump allocator for the packed object images held by an undo_state
+    *
+    *  Memory is handed out from fixed size chunks and is only released in bulk by clear() or when the arena is
+    *  destroyed.  Pointers into the arena stay valid when its chunks are moved to another arena by adopt().
+    */
+   class undo_arena
+   {
+      public:
+         static const size_t chunk_size = 64 * 1024;
+
+         undo_arena() {}
+         undo_arena( undo_arena&& other ) { *this = std::move(other); }
+         undo_arena& operator=( undo_arena&& other )
+         {
+            _chunks   = std::move( other._chunks );
+            _used     = other._used;
+            _capacity = other._capacity;
+            other._chunks.clear();
+            other._used = other._capacity = 0;
+            return *this;
+         }
+
+         char* allocate( size_t size )
+         {
+            if( _chunks.empty() || _used + size > _capacity )
+            {
+               _capacity = size > chunk_size ? size : chunk_size;
+               _chunks.emplace_back( new char[_capacity] );
+               _used = 0;
+            }
+            char* result = _chunks.back().get() + _used;
+            _used += size;
+            return result;
+         }
+
+         /** takes ownership of all memory allocated by other, allocation continues in this arena's current chunk */
+         void adopt( undo_arena&& other )
+         {
+            _chunks.insert( _chunks.begin(),
+                            std::make_move_iterator( other._chunks.begin() ),
+                            std::make_move_iterator( other._chunks.end() ) );
+            other._chunks.clear();
+            other._used = other._capacity = 0;
+         }
+
+         /** releases everything except a single regular sized chunk, which is kept for reuse */
+         void clear()
+         {
+            if( !_chunks.empty() && _capacity == chunk_size )
+            {
+               std::unique_ptr<char[]> last = std::move( _chunks.back() );
+               _chunks.clear();
+               _chunks.push_back( std::move(last) );
+            }
+            else
+            {
+               _chunks.clear();
+               _capacity = 0;
+            }
+            _used = 0;
+         }
+
+      private:
+         std::vector< std::unique_ptr<char[]> > _chunks;
+         size_t                                 _used     = 0;
+         size_t                                 _capacity = 0;
+   };
+
+   /** a packed object image stored in an undo_arena */
+   struct packed_object
+   {
+      const char* data = nullptr;
+      uint32_t    size = 0;
+   };
+
    struct undo_state
    {
-      unordered_map<object_id_type, unique_ptr<object> > old_values;
-      unordered_map<object_id_type, object_id_type>      old_index_next_ids;
-      std::unordered_set<object_id_type>                 new_ids;
-      unordered_map<object_id_type, unique_ptr<object> > removed;
+      /** the packed value of each modified object before its first modification in this state */
+      flat_id_map<packed_object>         old_values;
+      flat_id_map<object_id_type>        old_index_next_ids;
+      flat_id_set                        new_ids;
+      flat_id_map< unique_ptr<object> >  removed;
+      /** owns the memory referenced by old_values */
+      undo_arena                         arena;
+
+      bool empty()const
+      {
+         return old_values.empty() && old_index_next_ids.empty() && new_ids.empty() && removed.empty();
+      }
+      void clear()
+      {
+         old_values.clear();
+         old_index_next_ids.clear();
+         new_ids.clear();
+         removed.clear();
+         arena.clear();
+      }
    };
 
 
@@ -103,8 +196,13 @@ namespace graphene { namespace db {
           * If it's a new object as of this undo state, its pre-modification value is not stored, because prior to this
           * undo state, it did not exist. Any modifications in this undo state are irrelevant, as the object will simply
           * be removed if we undo.
+          *
+          * The pre-modification value is stored in its packed form, which is a single flat buffer no matter how many
+          * containers the object holds, and is only unpacked again if the state is actually undone.
+          *
+          * @return the number of bytes saved, which is zero if a pre-image was not needed
           */
-         void on_modify( const object& obj );
+         size_t on_modify( const object& obj );
          /**
           * This should be called just before an object is removed.
           *
@@ -134,9 +232,15 @@ namespace graphene { namespace db {
          void merge();
          void commit();
 
+         /** pushes an empty state onto the stack, reusing the storage of a recycled state if possible */
+         void push_state();
+         /** makes the storage of a state that was removed from the stack available to push_state() */
+         void recycle_state( undo_state&& state );
+
          uint32_t                _active_sessions = 0;
          bool                    _disabled = true;
          std::deque<undo_state>  _stack;
+         std::vector<undo_state> _spare_states;
          object_database&        _db;
          size_t                  _max_size = 256;
    };
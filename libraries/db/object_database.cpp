@@ -23,9 +23,142 @@
 #include <fc/io/raw.hpp>
 #include <fc/container/flat.hpp>
 #include <fc/uint128.hpp>
+#include <fc/filesystem.hpp>
+#include <fc/io/fstream.hpp>
+#include <fc/thread/thread.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <set>
+#include <thread>
+
+namespace graphene { namespace db { namespace detail {
+   /**
+    *  The contents of one file written by object_database::write_checkpoint(), or of the file the checkpoints up
+    *  to and including sequence are merged into by object_database::merge_checkpoints()
+    */
+   struct checkpoint_delta
+   {
+      uint32_t                                        sequence = 0;
+      vector<object_id_type>                          next_ids;
+      vector<object_id_type>                          removed;
+      vector< std::pair<object_id_type,vector<char>> > objects;
+   };
+} } }
+
+FC_REFLECT( graphene::db::detail::checkpoint_delta, (sequence)(next_ids)(removed)(objects) )
 
 namespace graphene { namespace db {
 
+namespace {
+   /**
+    *  Runs each of the tasks on a pool of worker threads and waits for all of them to complete.  Tasks
+    *  are handed out in order, so callers should put the most expensive ones first.  The first exception
+    *  thrown by any task is rethrown once every worker has stopped.
+    */
+   void run_in_parallel( const vector< std::function<void()> >& tasks )
+   {
+      if( tasks.empty() ) return;
+      const size_t worker_count = std::min<size_t>( tasks.size(), std::max( 1u, std::thread::hardware_concurrency() ) );
+
+      std::atomic<size_t> next_task( 0 );
+      vector< std::shared_ptr<fc::thread> > workers;
+      vector< fc::future<void> >            done;
+      workers.reserve( worker_count );
+      done.reserve( worker_count );
+      for( size_t i = 0; i < worker_count; ++i )
+      {
+         workers.push_back( std::make_shared<fc::thread>( "object_database_" + fc::to_string( uint64_t(i) ) ) );
+         done.push_back( workers.back()->async( [&]() {
+            for( size_t t = next_task++; t < tasks.size(); t = next_task++ )
+               tasks[t]();
+         }, "object_database worker" ) );
+      }
+
+      std::shared_ptr<fc::exception> error;
+      for( auto& f : done )
+      {
+         try {
+            f.wait();
+         } catch( const fc::exception& e ) {
+            if( !error ) error = e.dynamic_copy_exception();
+            next_task = tasks.size();
+         }
+      }
+      if( error ) error->dynamic_rethrow_exception();
+   }
+
+   detail::checkpoint_delta read_checkpoint( const fc::path& file )
+   {
+      std::string data;
+      fc::read_file_contents( file, data );
+      return fc::raw::unpack<detail::checkpoint_delta>( vector<char>( data.begin(), data.end() ) );
+   }
+
+   /** writes to a temporary file first, so that file either holds the whole delta or is left as it was */
+   void write_checkpoint_file( const fc::path& file, const detail::checkpoint_delta& delta )
+   {
+      const fc::path tmp = file.generic_string() + ".tmp";
+      {
+         std::ofstream out( tmp.generic_string(), std::ofstream::binary | std::ofstream::out | std::ofstream::trunc );
+         FC_ASSERT( out );
+         auto packed = fc::raw::pack( delta );
+         out.write( packed.data(), packed.size() );
+         out.flush();
+         FC_ASSERT( out, "Error writing checkpoint", ("file",tmp) );
+      }
+      fc::rename( tmp, file );
+   }
+
+   /**
+    *  Folds the checkpoints after the ones already merged, up to and including last, into the merged file and
+    *  removes them.  Only files are touched, so this runs on a background thread while the database goes on.
+    */
+   void merge_checkpoint_files( const fc::path& dir, uint32_t last )
+   {
+      const fc::path merged_file = dir / "merged";
+      detail::checkpoint_delta merged;
+      if( fc::exists( merged_file ) )
+         merged = read_checkpoint( merged_file );
+      const uint32_t first = merged.sequence + 1;
+      if( first > last )
+         return;
+
+      std::map< object_id_type, vector<char> > objects( merged.objects.begin(), merged.objects.end() );
+      std::set< object_id_type >               removed( merged.removed.begin(), merged.removed.end() );
+      for( uint32_t sequence = first; sequence <= last; ++sequence )
+      {
+         detail::checkpoint_delta delta = read_checkpoint( dir / fc::to_string( uint64_t(sequence) ) );
+         FC_ASSERT( delta.sequence == sequence, "", ("sequence",sequence)("delta",delta.sequence) );
+         for( const auto& id : delta.removed )
+         {
+            objects.erase( id );
+            removed.insert( id );
+         }
+         for( auto& item : delta.objects )
+         {
+            removed.erase( item.first );
+            objects[item.first] = std::move( item.second );
+         }
+         merged.next_ids = std::move( delta.next_ids );
+      }
+
+      merged.sequence = last;
+      merged.removed.assign( removed.begin(), removed.end() );
+      merged.objects.clear();
+      merged.objects.reserve( objects.size() );
+      for( auto& item : objects )
+         merged.objects.emplace_back( item.first, std::move( item.second ) );
+      write_checkpoint_file( merged_file, merged );
+
+      // open() starts after the merged sequence, so a crash before these are gone leaves them unused
+      for( uint32_t sequence = first; sequence <= last; ++sequence )
+         fc::remove_all( dir / fc::to_string( uint64_t(sequence) ) );
+   }
+}
+
 object_database::object_database()
 :_undo_db(*this)
 {
@@ -33,7 +166,10 @@ object_database::object_database()
    _undo_db.enable();
 }
 
-object_database::~object_database(){}
+object_database::~object_database()
+{
+   wait_for_checkpoint_merge();
+}
 
 void object_database::close()
 {
@@ -65,24 +201,169 @@ index& object_database::get_mutable_index(uint8_t space_id, uint8_t type_id)
    return *idx;
 }
 
-void object_database::flush()
+void object_database::save_indexes( const fc::path& dir )
 {
-//   ilog("Save object_database in ${d}", ("d", _data_dir));
+   vector< std::function<void()> > tasks;
    for( uint32_t space = 0; space < _index.size(); ++space )
    {
-      fc::create_directories( _data_dir / "object_database" / fc::to_string(space) );
+      fc::create_directories( dir / fc::to_string(space) );
       const auto types = _index[space].size();
       for( uint32_t type = 0; type  <  types; ++type )
          if( _index[space][type] )
-            _index[space][type]->save( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
+         {
+            index* idx = _index[space][type].get();
+            fc::path file = dir / fc::to_string(space)/fc::to_string(type);
+            tasks.push_back( [idx,file]() { idx->save( file ); } );
+         }
+   }
+   run_in_parallel( tasks );
+}
+
+void object_database::flush()
+{
+//   ilog("Save object_database in ${d}", ("d", _data_dir));
+   // the checkpoints are dropped along with the old files below
+   wait_for_checkpoint_merge();
+   const fc::path current = _data_dir / "object_database";
+   const fc::path tmp     = _data_dir / "object_database.tmp";
+   const fc::path old     = _data_dir / "object_database.old";
+
+   fc::remove_all( tmp );
+   save_indexes( tmp );
+
+   // the checkpoints directory lives inside object_database, so it is dropped along with the old files
+   fc::remove_all( old );
+   if( fc::exists( current ) )
+      fc::rename( current, old );
+   fc::rename( tmp, current );
+   fc::remove_all( old );
+
+   _changed_objects.clear();
+   _checkpoint_sequence = 0;
+   _checkpoint_count = 0;
+}
+
+void object_database::write_checkpoint()
+{ try {
+   detail::checkpoint_delta delta;
+   delta.sequence = _checkpoint_sequence + 1;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            delta.next_ids.push_back( idx->get_next_id() );
+
+   delta.objects.reserve( _changed_objects.size() );
+   for( const auto& id : _changed_objects )
+   {
+      const object* obj = find_object( id );
+      if( obj != nullptr )
+         delta.objects.emplace_back( id, obj->pack() );
+      else
+         delta.removed.push_back( id );
    }
+
+   const fc::path dir = _data_dir / "object_database" / "checkpoints";
+   fc::create_directories( dir );
+   write_checkpoint_file( dir / fc::to_string( uint64_t(delta.sequence) ), delta );
+
+   _changed_objects.clear();
+   _checkpoint_sequence = delta.sequence;
+   ++_checkpoint_count;
+} FC_CAPTURE_AND_RETHROW( (_checkpoint_sequence)(_changed_objects.size()) ) }
+
+void object_database::merge_checkpoints()
+{
+   wait_for_checkpoint_merge();
+   if( _checkpoint_sequence == 0 )
+      return;
+   if( !_checkpoint_thread )
+      _checkpoint_thread = std::make_shared<fc::thread>( "checkpoint_merge" );
+   const fc::path dir = _data_dir / "object_database" / "checkpoints";
+   const uint32_t last = _checkpoint_sequence;
+   _checkpoint_merge = _checkpoint_thread->async( [dir,last]() { merge_checkpoint_files( dir, last ); },
+                                                  "merge checkpoints" );
 }
 
+void object_database::wait_for_checkpoint_merge()
+{
+   if( !_checkpoint_merge.valid() )
+      return;
+   try
+   {
+      _checkpoint_merge.wait();
+   }
+   catch( const fc::exception& e )
+   {
+      // nothing is removed before the merged file is complete, so the checkpoints are still usable as they are
+      wlog( "Unable to merge the object database checkpoints: ${e}", ("e", e.to_detail_string()) );
+   }
+   _checkpoint_merge = fc::future<void>();
+}
+
+void object_database::load_checkpoints()
+{ try {
+   wait_for_checkpoint_merge();
+   const fc::path dir = _data_dir / "object_database" / "checkpoints";
+   if( !fc::exists( dir ) ) return;
+
+   _checkpoint_sequence = 0;
+   _checkpoint_count = 0;
+   // checkpoints are applied strictly in order and stop at the first gap, anything after a gap is stale
+   const bool undo_enabled = _undo_db.enabled();
+   _undo_db.disable();
+   auto apply_delta = [&]( const detail::checkpoint_delta& delta )
+   {
+      for( const auto& id : delta.removed )
+      {
+         const object* obj = find_object( id );
+         if( obj != nullptr )
+            get_mutable_index( id ).remove( *obj );
+      }
+      for( const auto& item : delta.objects )
+      {
+         index& idx = get_mutable_index( item.first );
+         const object* obj = idx.find( item.first );
+         if( obj != nullptr )
+            idx.remove( *obj );
+         idx.load( item.second );
+      }
+      for( const auto& next_id : delta.next_ids )
+         get_mutable_index( next_id ).set_next_id( next_id );
+
+      _checkpoint_sequence = delta.sequence;
+      _checkpoint_count = delta.sequence;
+   };
+
+   // the merged file holds every checkpoint up to its sequence, the ones after it follow in their own files
+   if( fc::exists( dir / "merged" ) )
+      apply_delta( read_checkpoint( dir / "merged" ) );
+   for( uint32_t sequence = _checkpoint_sequence + 1; ; ++sequence )
+   {
+      const fc::path file = dir / fc::to_string( uint64_t(sequence) );
+      if( !fc::exists( file ) )
+         break;
+
+      detail::checkpoint_delta delta = read_checkpoint( file );
+      FC_ASSERT( delta.sequence == sequence, "", ("file",file)("sequence",delta.sequence) );
+      apply_delta( delta );
+   }
+   if( undo_enabled ) _undo_db.enable();
+   _changed_objects.clear();
+
+   ilog( "Applied ${n} object database checkpoints", ("n",_checkpoint_count) );
+} FC_CAPTURE_AND_RETHROW() }
+
 void object_database::wipe(const fc::path& data_dir)
 {
    close();
+   wait_for_checkpoint_merge();
    ilog("Wiping object database...");
    fc::remove_all(data_dir / "object_database");
+   fc::remove_all(data_dir / "object_database.tmp");
+   fc::remove_all(data_dir / "object_database.old");
+   _changed_objects.clear();
+   _checkpoint_sequence = 0;
+   _checkpoint_count = 0;
    ilog("Done wiping object databse.");
 }
 
@@ -90,32 +371,237 @@ void object_database::open(const fc::path& data_dir)
 { try {
    ilog("Opening object database from ${d} ...", ("d", data_dir));
    _data_dir = data_dir;
+
+   // a flush() that was interrupted after moving the previous files aside leaves them in object_database.old
+   if( !fc::exists( _data_dir / "object_database" ) && fc::exists( _data_dir / "object_database.old" ) )
+      fc::rename( _data_dir / "object_database.old", _data_dir / "object_database" );
+   fc::remove_all( _data_dir / "object_database.tmp" );
+
+   bulk_load_guard bulk_load( *this );
+   open_indexes( _data_dir / "object_database" );
+   load_checkpoints();
+   bulk_load.complete();
+   ilog( "Done opening object database." );
+
+} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+
+void object_database::open_from_snapshot( const fc::path& data_dir, const fc::path& snapshot_dir )
+{ try {
+   ilog( "Opening object database in ${d} from the snapshot in ${s} ...", ("d", data_dir)("s", snapshot_dir) );
+   FC_ASSERT( fc::exists( snapshot_dir ), "Snapshot ${s} does not exist", ("s", snapshot_dir) );
+   _data_dir = data_dir;
+
+   bulk_load_guard bulk_load( *this );
+   open_indexes( snapshot_dir );
+   bulk_load.complete();
+   flush();
+   ilog( "Done opening object database." );
+} FC_CAPTURE_AND_RETHROW( (data_dir)(snapshot_dir) ) }
+
+void object_database::save_snapshot( const fc::path& dir )
+{ try {
+   FC_ASSERT( !fc::exists( dir ), "Snapshot ${d} already exists", ("d", dir) );
+   save_indexes( dir );
+} FC_CAPTURE_AND_RETHROW( (dir) ) }
+
+void object_database::open_indexes( const fc::path& dir )
+{
+   // open the largest files first so that a single big index does not end up being started last
+   vector< std::pair<uint64_t, std::function<void()>> > jobs;
    for( uint32_t space = 0; space < _index.size(); ++space )
       for( uint32_t type = 0; type  < _index[space].size(); ++type )
          if( _index[space][type] )
-            _index[space][type]->open( _data_dir / "object_database" / fc::to_string(space)/fc::to_string(type) );
-   ilog( "Done opening object database." );
+         {
+            index* idx = _index[space][type].get();
+            fc::path file = dir / fc::to_string(space)/fc::to_string(type);
+            uint64_t size = fc::exists( file ) ? fc::file_size( file ) : 0;
+            jobs.emplace_back( size, [idx,file]() { idx->open( file ); } );
+         }
+   std::stable_sort( jobs.begin(), jobs.end(), []( const std::pair<uint64_t, std::function<void()>>& a,
+                                                   const std::pair<uint64_t, std::function<void()>>& b ) {
+      return a.first > b.first;
+   });
+   vector< std::function<void()> > tasks;
+   tasks.reserve( jobs.size() );
+   for( auto& job : jobs )
+      tasks.push_back( std::move( job.second ) );
+   run_in_parallel( tasks );
+}
 
-} FC_CAPTURE_AND_RETHROW( (data_dir) ) }
+void object_database::enable_read_views( bool enable )
+{
+   _track_view_changes = enable;
+   _view_changes.clear();
+   std::atomic_store( &_read_view, std::shared_ptr<const object_read_view>() );
+}
+
+void object_database::publish_read_view( uint64_t version )
+{ try {
+   const auto previous = std::atomic_load( &_read_view );
+   auto view = std::make_shared<object_read_view>();
+   view->_version = version;
+   if( previous )
+      view->_indexes = previous->_indexes;
+   view->_indexes.resize( std::max( view->_indexes.size(), _index.size() ) );
+   for( uint32_t space = 0; space < _index.size(); ++space )
+      view->_indexes[space].resize( std::max( view->_indexes[space].size(), _index[space].size() ) );
+
+   // pages shared with the previous view must be copied before they are changed, but only once per view
+   flat_id_set copied_indexes;
+   flat_id_set copied_pages;
+   auto set_object = [&]( object_id_type id, const object* obj )
+   {
+      auto& pages_ptr = view->_indexes[id.space()][id.type()];
+      if( copied_indexes.insert( object_id_type( id.space(), id.type(), 0 ) ) )
+         pages_ptr = pages_ptr ? std::make_shared<object_read_view::index_pages>( *pages_ptr )
+                               : std::make_shared<object_read_view::index_pages>();
+      auto& pages = *pages_ptr;
+
+      const uint64_t page_num = id.instance() / object_read_view::page_size;
+      if( pages.size() <= page_num )
+         pages.resize( page_num + 1 );
+      if( copied_pages.insert( object_id_type( id.space(), id.type(), page_num ) ) )
+         pages[page_num] = pages[page_num] ? std::make_shared<object_read_view::page>( *pages[page_num] )
+                                           : std::make_shared<object_read_view::page>();
+
+      (*pages[page_num])[id.instance() % object_read_view::page_size] =
+            obj ? object_read_view::object_ptr( obj->clone() ) : object_read_view::object_ptr();
+   };
+
+   if( !previous )
+   {
+      for( const auto& space : _index )
+         for( const auto& idx : space )
+            if( idx )
+               idx->inspect_all_objects( [&]( const object& o ) { set_object( o.id, &o ); } );
+   }
+   else
+   {
+      for( const auto& id : _view_changes )
+         set_object( id, find_object( id ) );
+   }
+   _view_changes.clear();
 
+   std::atomic_store( &_read_view, std::shared_ptr<const object_read_view>( std::move(view) ) );
+} FC_CAPTURE_AND_RETHROW( (version) ) }
 
 void object_database::pop_undo()
 { try {
    _undo_db.pop_commit();
 } FC_CAPTURE_AND_RETHROW() }
 
-void object_database::save_undo( const object& obj )
+void object_database::begin_bulk_load()
+{
+   _bulk_load = true;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->defer_secondary_indexes( true );
+}
+
+void object_database::end_bulk_load()
+{ try {
+   if( !_bulk_load ) return;
+   vector< std::function<void()> > tasks;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx && idx->has_secondary_indexes() )
+         {
+            index* i = idx.get();
+            tasks.push_back( [i]() { i->rebuild_secondary_indexes(); } );
+         }
+   run_in_parallel( tasks );
+
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            idx->defer_secondary_indexes( false );
+   _bulk_load = false;
+} FC_CAPTURE_AND_RETHROW() }
+
+object_database::bulk_load_guard::bulk_load_guard( object_database& db )
+   : _db( db ), _active( !db._bulk_load )
+{
+   if( _active )
+      _db.begin_bulk_load();
+}
+
+object_database::bulk_load_guard::~bulk_load_guard()
+{
+   if( !_active ) return;
+   try {
+      _db.end_bulk_load();
+   } catch( const fc::exception& e ) {
+      wlog( "Unable to rebuild the secondary indexes after a failed load: ${e}", ("e",e.to_detail_string()) );
+   } catch( ... ) {
+      wlog( "Unable to rebuild the secondary indexes after a failed load" );
+   }
+}
+
+void object_database::bulk_load_guard::complete()
+{
+   if( !_active ) return;
+   _active = false;
+   _db.end_bulk_load();
+}
+
+vector<index_statistics> object_database::get_index_statistics()const
+{
+   vector<index_statistics> result;
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            result.push_back( idx->get_statistics() );
+   return result;
+}
+
+void object_database::select_state_digest_indexes()
+{
+   _digest_indexes.clear();
+   for( const auto& space : _index )
+      for( const auto& idx : space )
+         if( idx )
+            _digest_indexes.push_back( idx.get() );
+   enable_state_digest( _track_digest );
+}
+
+void object_database::enable_state_digest( bool enable )
+{
+   _track_digest = enable;
+   for( auto* idx : _digest_indexes )
+      idx->enable_digest( enable );
+}
+
+fc::sha256 object_database::get_state_digest()const
+{
+   FC_ASSERT( _track_digest, "State digests are not enabled" );
+   fc::sha256::encoder enc;
+   for( const auto* idx : _digest_indexes )
+   {
+      fc::raw::pack( enc, idx->object_space_id() );
+      fc::raw::pack( enc, idx->object_type_id() );
+      const fc::uint128 digest = idx->digest();
+      fc::raw::pack( enc, digest.hi );
+      fc::raw::pack( enc, digest.lo );
+   }
+   return enc.result();
+}
+
+size_t object_database::save_undo( const object& obj )
 {
-   _undo_db.on_modify( obj );
+   record_change( obj.id );
+   return _undo_db.on_modify( obj );
 }
 
 void object_database::save_undo_add( const object& obj )
 {
+   record_change( obj.id );
    _undo_db.on_create( obj );
 }
 
 void object_database::save_undo_remove(const object& obj)
 {
+   record_change( obj.id );
    _undo_db.on_remove( obj );
 }
 
@@ -35,9 +35,12 @@ undo_database::session undo_database::start_undo_session( bool force_enable )
       _disabled = false;
 
    while( size() > max_size() )
+   {
+      recycle_state( std::move( _stack.front() ) );
       _stack.pop_front();
+   }
 
-   _stack.emplace_back();
+   push_state();
    ++_active_sessions;
    return session(*this, disable_on_exit );
 }
@@ -46,7 +49,7 @@ void undo_database::on_create( const object& obj )
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    auto index_id = object_id_type( obj.id.space(), obj.id.type(), 0 );
    auto itr = state.old_index_next_ids.find( index_id );
@@ -54,35 +57,43 @@ void undo_database::on_create( const object& obj )
       state.old_index_next_ids[index_id] = obj.id;
    state.new_ids.insert(obj.id);
 }
-void undo_database::on_modify( const object& obj )
+size_t undo_database::on_modify( const object& obj )
 {
-   if( _disabled ) return;
+   if( _disabled ) return 0;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    auto& state = _stack.back();
    if( state.new_ids.find(obj.id) != state.new_ids.end() )
-      return;
+      return 0;
    auto itr =  state.old_values.find(obj.id);
-   if( itr != state.old_values.end() ) return;
-   state.old_values[obj.id] = obj.clone();
+   if( itr != state.old_values.end() ) return 0;
+   packed_object& old_value = state.old_values[obj.id];
+   old_value.size = obj.packed_size();
+   char* data = state.arena.allocate( old_value.size );
+   obj.pack_to( data, old_value.size );
+   old_value.data = data;
+   return old_value.size;
 }
 void undo_database::on_remove( const object& obj )
 {
    if( _disabled ) return;
 
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    undo_state& state = _stack.back();
    if( state.new_ids.count(obj.id) )
    {
       state.new_ids.erase(obj.id);
       return;
    }
-   if( state.old_values.count(obj.id) )
+   auto itr = state.old_values.find(obj.id);
+   if( itr != state.old_values.end() )
    {
-      state.removed[obj.id] = std::move(state.old_values[obj.id]);
-      state.old_values.erase(obj.id);
+      unique_ptr<object> old_value = obj.clone();
+      old_value->unpack_from( itr->second.data, itr->second.size );
+      state.removed[obj.id] = std::move(old_value);
+      state.old_values.erase(itr);
       return;
    }
    if( state.removed.count(obj.id) ) return;
@@ -98,7 +109,7 @@ void undo_database::undo()
    auto& state = _stack.back();
    for( auto& item : state.old_values )
    {
-      _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
+      _db.modify( _db.get_object( item.first ), [&]( object& obj ){ obj.unpack_from( item.second.data, item.second.size ); } );
    }
 
    for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
@@ -114,9 +125,10 @@ void undo_database::undo()
    for( auto& item : state.removed )
       _db.insert( std::move(*item.second) );
 
+   recycle_state( std::move( _stack.back() ) );
    _stack.pop_back();
    if( _stack.empty() )
-      _stack.emplace_back();
+      push_state();
    enable();
    --_active_sessions;
 } FC_CAPTURE_AND_RETHROW() }
@@ -128,6 +140,19 @@ void undo_database::merge()
    auto& state = _stack.back();
    auto& prev_state = _stack[_stack.size()-2];
 
+   // nop+X -> X, type B for every object, so the whole state can simply be moved
+   if( prev_state.empty() )
+   {
+      recycle_state( std::move( prev_state ) );
+      prev_state = std::move( state );
+      _stack.pop_back();
+      --_active_sessions;
+      return;
+   }
+
+   // the old values that move to prev_state below still point into this state's arena
+   prev_state.arena.adopt( std::move( state.arena ) );
+
    // An object's relationship to a state can be:
    // in new_ids            : new
    // in old_values (was=X) : upd(was=X)
@@ -173,20 +198,20 @@ void undo_database::merge()
    // *+upd
    for( auto& obj : state.old_values )
    {
-      if( prev_state.new_ids.find(obj.second->id) != prev_state.new_ids.end() )
+      if( prev_state.new_ids.find(obj.first) != prev_state.new_ids.end() )
       {
          // new+upd -> new, type A
          continue;
       }
-      if( prev_state.old_values.find(obj.second->id) != prev_state.old_values.end() )
+      if( prev_state.old_values.find(obj.first) != prev_state.old_values.end() )
       {
          // upd(was=X) + upd(was=Y) -> upd(was=X), type A
          continue;
       }
       // del+upd -> N/A
-      assert( prev_state.removed.find(obj.second->id) == prev_state.removed.end() );
+      assert( prev_state.removed.find(obj.first) == prev_state.removed.end() );
       // nop+upd(was=Y) -> upd(was=Y), type B
-      prev_state.old_values[obj.second->id] = std::move(obj.second);
+      prev_state.old_values[obj.first] = std::move(obj.second);
    }
 
    // *+new, but we assume the N/A cases don't happen, leaving type B nop+new -> new
@@ -223,8 +248,9 @@ void undo_database::merge()
       if( it != prev_state.old_values.end() )
       {
          // upd(was=X) + del(was=Y) -> del(was=X)
-         prev_state.removed[obj.second->id] = std::move(it->second);
-         prev_state.old_values.erase(obj.second->id);
+         obj.second->unpack_from( it->second.data, it->second.size );
+         prev_state.removed[obj.second->id] = std::move(obj.second);
+         prev_state.old_values.erase(it);
          continue;
       }
       // del + del -> N/A
@@ -232,6 +258,7 @@ void undo_database::merge()
       // nop + del(was=Y) -> del(was=Y)
       prev_state.removed[obj.second->id] = std::move(obj.second);
    }
+   recycle_state( std::move( state ) );
    _stack.pop_back();
    --_active_sessions;
 }
@@ -252,7 +279,7 @@ void undo_database::pop_commit()
 
       for( auto& item : state.old_values )
       {
-         _db.modify( _db.get_object( item.second->id ), [&]( object& obj ){ obj.move_from( *item.second ); } );
+         _db.modify( _db.get_object( item.first ), [&]( object& obj ){ obj.unpack_from( item.second.data, item.second.size ); } );
       }
 
       for( auto ritr = state.new_ids.begin(); ritr != state.new_ids.end(); ++ritr  )
@@ -268,6 +295,7 @@ void undo_database::pop_commit()
       for( auto& item : state.removed )
          _db.insert( std::move(*item.second) );
 
+      recycle_state( std::move( _stack.back() ) );
       _stack.pop_back();
    }
    catch ( const fc::exception& e )
@@ -278,6 +306,31 @@ void undo_database::pop_commit()
    }
    enable();
 }
+void undo_database::push_state()
+{
+   if( _spare_states.empty() )
+   {
+      _stack.emplace_back();
+      return;
+   }
+   _stack.emplace_back( std::move( _spare_states.back() ) );
+   _spare_states.pop_back();
+}
+
+void undo_database::recycle_state( undo_state&& state )
+{
+   // keep a few states around so that the temporary per transaction sessions do not allocate, but do not hold on
+   // to the tables of states that grew large while applying a whole block
+   const size_t max_spare_states = 8;
+   const size_t max_spare_capacity = 1024;
+   if( _spare_states.size() >= max_spare_states ||
+       state.old_values.capacity() > max_spare_capacity || state.new_ids.capacity() > max_spare_capacity ||
+       state.old_index_next_ids.capacity() > max_spare_capacity || state.removed.capacity() > max_spare_capacity )
+      return;
+   state.clear();
+   _spare_states.push_back( std::move(state) );
+}
+
 const undo_state& undo_database::head()const
 {
    FC_ASSERT( !_stack.empty() );
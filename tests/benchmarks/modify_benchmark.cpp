@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/smart_ref_impl.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+namespace {
+   int64_t elapsed_us( fc::time_point start ) { return (fc::time_point::now() - start).count(); }
+}
+
+/**
+ *  Measures the cost of database::create and database::modify on indexes without secondary indexes or
+ *  observers, with and without an undo session, for both a generic_index and a simple_index.
+ */
+BOOST_AUTO_TEST_CASE( create_modify_bench )
+{
+   try {
+      const uint32_t object_count = 10000;
+      const uint32_t rounds = 100;
+
+      database db;
+      vector<const account_balance_object*> balances;
+      vector<const account_statistics_object*> stats;
+      balances.reserve( object_count );
+      stats.reserve( object_count );
+
+      auto start = fc::time_point::now();
+      for( uint32_t i = 0; i < object_count; ++i )
+      {
+         balances.push_back( &db.create<account_balance_object>( [&]( account_balance_object& b ) {
+            b.owner = account_id_type( i );
+         }) );
+         stats.push_back( &db.create<account_statistics_object>( [&]( account_statistics_object& s ) {
+            s.owner = account_id_type( i );
+         }) );
+      }
+      ilog( "Created ${n} objects in ${t} us", ("n",2 * object_count)("t",elapsed_us( start )) );
+
+      start = fc::time_point::now();
+      for( uint32_t round = 0; round < rounds; ++round )
+         for( const auto* b : balances )
+            db.modify( *b, [&]( account_balance_object& o ) { o.balance += round; } );
+      ilog( "generic_index: ${n} modifications without undo in ${t} us", ("n",object_count * rounds)("t",elapsed_us( start )) );
+
+      start = fc::time_point::now();
+      for( uint32_t round = 0; round < rounds; ++round )
+         for( const auto* s : stats )
+            db.modify( *s, [&]( account_statistics_object& o ) { o.total_core_in_orders += round; } );
+      ilog( "simple_index: ${n} modifications without undo in ${t} us", ("n",object_count * rounds)("t",elapsed_us( start )) );
+
+      int64_t generic_us = 0, simple_us = 0;
+      for( uint32_t round = 0; round < rounds; ++round )
+      {
+         auto session = db._undo_db.start_undo_session( true );
+         start = fc::time_point::now();
+         for( const auto* b : balances )
+            db.modify( *b, [&]( account_balance_object& o ) { o.balance += round; } );
+         generic_us += elapsed_us( start );
+         start = fc::time_point::now();
+         for( const auto* s : stats )
+            db.modify( *s, [&]( account_statistics_object& o ) { o.total_core_in_orders += round; } );
+         simple_us += elapsed_us( start );
+         session.undo();
+      }
+      ilog( "generic_index: ${n} modifications with undo in ${t} us", ("n",object_count * rounds)("t",generic_us) );
+      ilog( "simple_index: ${n} modifications with undo in ${t} us", ("n",object_count * rounds)("t",simple_us) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
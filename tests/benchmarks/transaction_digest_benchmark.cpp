@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/protocol/protocol.hpp>
+
+#include <fc/crypto/digest.hpp>
+#include <fc/smart_ref_impl.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+namespace {
+   int64_t elapsed_us( fc::time_point start ) { return (fc::time_point::now() - start).count(); }
+}
+
+/**
+ *  Measures what the pending transactions cost to serialize each time they are checked again: the id, the
+ *  signature digest and the packed size computed separately, serializing the transaction for each of them, against
+ *  signed_transaction::compute_digests() serializing it once.
+ */
+BOOST_AUTO_TEST_CASE( transaction_digest_bench )
+{
+   try {
+      const uint32_t trx_count = 10000;
+      const uint32_t ops_per_trx = 4;
+      const uint32_t rounds = 10;
+
+      const chain_id_type chain_id = fc::sha256::hash( string( "benchmark" ) );
+      const auto key = fc::ecc::private_key::regenerate( fc::sha256::hash( string( "key" ) ) );
+
+      vector<signed_transaction> trxs( trx_count );
+      for( uint32_t i = 0; i < trx_count; ++i )
+      {
+         signed_transaction& trx = trxs[i];
+         trx.expiration = fc::time_point_sec( 1500000000 + i );
+         for( uint32_t j = 0; j < ops_per_trx; ++j )
+         {
+            transfer_operation op;
+            op.from = account_id_type( i );
+            op.to = account_id_type( j );
+            op.amount = asset( i * ops_per_trx + j );
+            trx.operations.push_back( op );
+         }
+         trx.sign( key, chain_id );
+      }
+
+      // the transaction serializations each pending transaction went through when checked again after a block:
+      // its id to find out whether it is known, its id for the duplicate check and its signature digest
+      int64_t separate_us = 0, once_us = 0;
+      uint64_t check = 0;
+      for( uint32_t round = 0; round < rounds; ++round )
+      {
+         auto start = fc::time_point::now();
+         for( const auto& trx : trxs )
+         {
+            check += trx.id()._hash[0];
+            check += trx.id()._hash[1];
+            check += trx.sig_digest( chain_id )._hash[0];
+            check += fc::raw::pack_size( trx );
+         }
+         separate_us += elapsed_us( start );
+
+         start = fc::time_point::now();
+         for( const auto& trx : trxs )
+         {
+            const transaction_digests d = trx.compute_digests( &chain_id );
+            check -= d.id._hash[0];
+            check -= d.id._hash[1];
+            check -= d.sig_digest->_hash[0];
+            check -= d.pack_size;
+         }
+         once_us += elapsed_us( start );
+      }
+      BOOST_CHECK_EQUAL( check, 0u );
+
+      ilog( "Separately: 4 serializations per transaction, ${t} us for ${n} transactions",
+            ("t",separate_us / rounds)("n",trx_count) );
+      ilog( "compute_digests: 1 serialization per transaction, ${t} us for ${n} transactions",
+            ("t",once_us / rounds)("n",trx_count) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
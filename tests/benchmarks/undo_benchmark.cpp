@@ -0,0 +1,100 @@
+/*
+ * Copyright (c) 2015 Cryptonomex, Inc., and contributors.
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without modification, are permitted provided that the following conditions are met:
+ *
+ * 1. Any modified source or binaries are used only with the BitShares network.
+ *
+ * 2. Redistributions of source code must retain the above copyright notice, this list of conditions and the following disclaimer.
+ *
+ * 3. Redistributions in binary form must reproduce the above copyright notice, this list of conditions and the following disclaimer in the documentation and/or other materials provided with the distribution.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+ * THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY,
+ * WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF
+ * ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ *
+ */
+#include <graphene/chain/database.hpp>
+#include <graphene/chain/account_object.hpp>
+
+#include <fc/smart_ref_impl.hpp>
+
+#include <boost/test/auto_unit_test.hpp>
+
+using namespace graphene::chain;
+
+namespace {
+   int64_t elapsed_us( fc::time_point start ) { return (fc::time_point::now() - start).count(); }
+}
+
+BOOST_AUTO_TEST_CASE( undo_session_bench )
+{
+   try {
+      const uint32_t object_count = 10000;
+      const uint32_t rounds = 20;
+      const uint32_t objects_per_trx = 10;
+
+      database db;
+      vector<const account_balance_object*> objects;
+      objects.reserve( object_count );
+
+      int64_t create_us = 0, modify_merge_us = 0, trx_merge_us = 0, undo_us = 0;
+      for( uint32_t round = 0; round < rounds; ++round )
+      {
+         auto block_session = db._undo_db.start_undo_session();
+
+         // push: create a full session worth of objects
+         auto start = fc::time_point::now();
+         objects.clear();
+         for( uint32_t i = 0; i < object_count; ++i )
+            objects.push_back( &db.create<account_balance_object>( [&]( account_balance_object& b ) {
+               b.owner = account_id_type( i );
+               b.balance = i;
+            }) );
+         block_session.commit();
+         create_us += elapsed_us( start );
+
+         // merge: modify every object in a child session and fold it into its parent
+         block_session = db._undo_db.start_undo_session();
+         start = fc::time_point::now();
+         {
+            auto child = db._undo_db.start_undo_session();
+            for( const auto* b : objects )
+               db.modify( *b, []( account_balance_object& o ) { o.balance += 1; } );
+            child.merge();
+         }
+         modify_merge_us += elapsed_us( start );
+
+         // the _push_transaction pattern, one small temporary session per transaction merged into the pending state
+         start = fc::time_point::now();
+         for( uint32_t i = 0; i + objects_per_trx <= object_count; i += objects_per_trx )
+         {
+            auto trx_session = db._undo_db.start_undo_session();
+            for( uint32_t j = i; j < i + objects_per_trx; ++j )
+               db.modify( *objects[j], []( account_balance_object& o ) { o.balance += 1; } );
+            trx_session.merge();
+         }
+         trx_merge_us += elapsed_us( start );
+
+         // undo: roll back the modifications, then the creations
+         start = fc::time_point::now();
+         block_session.undo();
+         db._undo_db.pop_commit();
+         undo_us += elapsed_us( start );
+
+         BOOST_CHECK( db.find_object( account_balance_id_type( 0 ) ) == nullptr );
+      }
+
+      ilog( "Created and committed ${n} objects in ${t} us per session", ("n",object_count)("t",create_us / rounds) );
+      ilog( "Modified and merged ${n} objects in ${t} us per session", ("n",object_count)("t",modify_merge_us / rounds) );
+      ilog( "Merged ${c} sessions of ${n} objects each in ${t} us", ("c",object_count / objects_per_trx)("n",objects_per_trx)("t",trx_merge_us / rounds) );
+      ilog( "Undid ${n} modifications and creations in ${t} us per session", ("n",object_count)("t",undo_us / rounds) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
@@ -747,6 +747,25 @@ void database_fixture::transfer(
    } FC_CAPTURE_AND_RETHROW( (from.id)(to.id)(amount)(fee) )
 }
 
+signed_transaction database_fixture::make_transfer(
+   account_id_type from,
+   account_id_type to,
+   const asset& amount,
+   const fc::ecc::private_key& key,
+   const asset& fee /* = asset() */ )
+{
+   transfer_operation op;
+   op.from = from;
+   op.to = to;
+   op.amount = amount;
+   op.fee = fee;
+   signed_transaction tx;
+   tx.operations.push_back( op );
+   set_expiration( db, tx );
+   sign( tx, key );
+   return tx;
+}
+
 void database_fixture::update_feed_producers( const asset_object& mia, flat_set<account_id_type> producers )
 { try {
    set_expiration( db, trx );
@@ -33,9 +33,14 @@
 #include <graphene/utilities/tempdir.hpp>
 
 #include <fc/crypto/digest.hpp>
+#include <fc/io/json.hpp>
 
 #include "../common/database_fixture.hpp"
 
+#include <atomic>
+#include <fstream>
+#include <thread>
+
 using namespace graphene::chain;
 using namespace graphene::chain::test;
 
@@ -116,6 +121,190 @@ BOOST_AUTO_TEST_CASE( block_database_test )
          FC_ASSERT( blk->witness == witness_id_type(blk->block_num()) );
       }
 
+      vector<block_id_type> ids = bdb.fetch_block_ids( 1, 5 );
+      BOOST_REQUIRE_EQUAL( ids.size(), 5 );
+      for( uint32_t i = 0; i < 5; ++i )
+         BOOST_CHECK( ids[i] == bdb.fetch_block_id( i+1 ) );
+      BOOST_CHECK( bdb.fetch_block_ids( 3, 2 ).empty() );
+      BOOST_CHECK_THROW( bdb.fetch_block_ids( 4, 6 ), fc::key_not_found_exception );
+      ids = bdb.fetch_block_ids( vector<uint32_t>{ 1, 3, 5 } );
+      BOOST_REQUIRE_EQUAL( ids.size(), 3 );
+      BOOST_CHECK( ids[1] == bdb.fetch_block_id( 3 ) );
+      BOOST_CHECK( ids[2] == b.id() );
+
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_concurrent_read_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      block_database bdb;
+      bdb.open( data_dir.path() );
+
+      // enough blocks to grow the index past its first mapped chunk while another thread reads
+      const uint32_t block_count = 70000;
+      std::atomic<uint32_t> stored( 0 );
+      std::atomic<bool> reader_failed( false );
+      std::thread reader( [&]() {
+         uint32_t checked = 0;
+         while( stored < block_count )
+         {
+            const uint32_t head = stored;
+            if( head == 0 ) continue;
+            const uint32_t num = 1 + checked++ % head;
+            auto blk = bdb.fetch_by_number( num );
+            if( !blk.valid() || blk->witness != witness_id_type( num ) || bdb.fetch_block_id( num ) != blk->id() )
+               reader_failed = true;
+         }
+      });
+
+      signed_block b;
+      for( uint32_t i = 0; i < block_count; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         ++stored;
+      }
+      reader.join();
+      BOOST_CHECK( !reader_failed );
+      BOOST_CHECK( bdb.last_id() == b.id() );
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.last_id() == b.id() );
+      BOOST_CHECK( bdb.fetch_by_number( block_count / 2 )->witness == witness_id_type( block_count / 2 ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_segment_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+
+      // segments of 100 blocks, sealed once the chain is 20 blocks past them
+      block_database bdb( 100, 20 );
+      bdb.open( data_dir.path() );
+
+      signed_block b;
+      vector<block_id_type> ids( 1 );
+      for( uint32_t i = 0; i < 450; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      // segments are compressed in the background
+      bdb.wait_for_sealing();
+      const fc::path segments = data_dir.path() / "segments";
+      BOOST_CHECK( fc::exists( segments / "2.zblocks" ) );
+      BOOST_CHECK( !fc::exists( segments / "2.blocks" ) );
+      BOOST_CHECK( fc::exists( segments / "3.blocks" ) );
+      BOOST_CHECK( fc::exists( segments / "4.blocks" ) );
+
+      for( uint32_t num = 1; num <= 450; ++num )
+      {
+         auto blk = bdb.fetch_by_number( num );
+         BOOST_REQUIRE( blk.valid() );
+         BOOST_CHECK( blk->witness == witness_id_type( num ) );
+         BOOST_CHECK( bdb.fetch_optional( ids[num] )->id() == ids[num] );
+      }
+
+      // storing into a sealed segment inflates it again
+      bdb.remove( ids[150] );
+      BOOST_CHECK( !bdb.fetch_by_number( 150 ).valid() );
+      b = *bdb.fetch_by_number( 149 );
+      b.previous = b.id();
+      b.witness = witness_id_type( 1000 );
+      bdb.store( b.id(), b );
+      BOOST_CHECK( fc::exists( segments / "1.blocks" ) );
+      BOOST_CHECK( !fc::exists( segments / "1.zblocks" ) );
+      BOOST_CHECK( bdb.fetch_by_number( 150 )->witness == witness_id_type( 1000 ) );
+      BOOST_CHECK( bdb.fetch_by_number( 151 )->witness == witness_id_type( 151 ) );
+
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.last_id() == ids[450] );
+      for( uint32_t num = 1; num <= 450; ++num )
+         BOOST_CHECK( bdb.fetch_by_number( num ).valid() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( block_database_recovery_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      const fc::path segments = data_dir.path() / "segments";
+
+      block_database bdb( 100, 20 );
+      bdb.set_sync_policy( 0, 0 );
+      bdb.open( data_dir.path() );
+
+      signed_block b;
+      vector<block_id_type> ids( 1 );
+      for( uint32_t i = 0; i < 100; ++i )
+      {
+         if( i > 0 ) b.previous = b.id();
+         b.witness = witness_id_type(i+1);
+         bdb.store( b.id(), b );
+         ids.push_back( b.id() );
+      }
+      bdb.close();
+
+      // pretend only the first 50 blocks reached the disk and block 80 was torn by a crash
+      {
+         std::fstream synced( (segments / "synced").generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         const uint32_t synced_through = 50;
+         synced.write( (const char*)&synced_through, sizeof(synced_through) );
+
+         std::ifstream entries( (segments / "entries").generic_string(), std::ios::binary );
+         uint64_t block_pos = 0;
+         entries.seekg( 80 * 40 );
+         entries.read( (char*)&block_pos, sizeof(block_pos) );
+
+         std::fstream blocks( (segments / "0.blocks").generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         blocks.seekp( block_pos + 20 );
+         blocks.put( 'Z' );
+      }
+
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.last_id() == ids[79] );
+      BOOST_CHECK( !bdb.fetch_by_number( 80 ).valid() );
+      BOOST_CHECK( !bdb.fetch_optional( ids[90] ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 60 )->witness == witness_id_type( 60 ) );
+
+      // blocks popped before a clean shutdown do not come back
+      for( uint32_t num = 79; num >= 75; --num )
+         bdb.remove( ids[num] );
+      bdb.close();
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.last_id() == ids[74] );
+      BOOST_CHECK( !bdb.fetch_by_number( 75 ).valid() );
+
+      // a block popped in the middle of the entries still being checked does not cut the blocks after it
+      bdb.remove( ids[70] );
+      bdb.close();
+      {
+         std::fstream synced( (segments / "synced").generic_string(), std::ios::in | std::ios::out | std::ios::binary );
+         const uint32_t synced_through = 60;
+         synced.write( (const char*)&synced_through, sizeof(synced_through) );
+      }
+      bdb.open( data_dir.path() );
+      BOOST_CHECK( bdb.last_id() == ids[74] );
+      BOOST_CHECK( !bdb.fetch_by_number( 70 ).valid() );
+      BOOST_CHECK( bdb.fetch_by_number( 71 )->witness == witness_id_type( 71 ) );
    } catch (fc::exception& e) {
       edump((e.to_detail_string()));
       throw;
@@ -177,6 +366,106 @@ BOOST_AUTO_TEST_CASE( generate_empty_blocks )
    }
 }
 
+BOOST_AUTO_TEST_CASE( reindex_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      uint32_t head_num;
+      block_id_type head_id;
+      fc::sha256 head_digest;
+      {
+         database db;
+         db.enable_state_digest( true );
+         db.open(data_dir.path(), make_genesis );
+         // enough blocks to keep the prefetch workers well ahead of the replay
+         for( uint32_t i = 0; i < 1000; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         db.close();
+      }
+      {
+         database db;
+         db.enable_state_digest( true );
+         db.open(data_dir.path(), []{return genesis_state_type();});
+         head_num = db.head_block_num();
+         head_id = db.head_block_id();
+         head_digest = db.head_state_digest();
+         BOOST_CHECK( head_num > 900 );
+      }
+      {
+         database db;
+         db.enable_state_digest( true );
+         db.reindex( data_dir.path(), make_genesis() );
+         BOOST_CHECK_EQUAL( db.head_block_num(), head_num );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK( db.head_state_digest() == head_digest );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( snapshot_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      fc::temp_directory snapshot_parent( graphene::utilities::temp_directory_path() );
+      fc::temp_directory import_dir( graphene::utilities::temp_directory_path() );
+      const fc::path snapshot_dir = snapshot_parent.path() / "snapshot";
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      snapshot_manifest manifest;
+      block_id_type head_id;
+      {
+         database db;
+         db.open(data_dir.path(), make_genesis );
+         for( uint32_t i = 0; i < 100; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         const uint32_t irreversible = db.get_dynamic_global_properties().last_irreversible_block_num;
+         BOOST_REQUIRE( irreversible > 0 && irreversible < db.head_block_num() );
+
+         db.create_snapshot( snapshot_dir );
+         BOOST_CHECK_EQUAL( db.head_block_num(), irreversible );
+         manifest = fc::json::from_file( snapshot_dir / "snapshot.json" ).as<snapshot_manifest>();
+         BOOST_CHECK_EQUAL( manifest.block_num, irreversible );
+         BOOST_CHECK( manifest.block_id == db.head_block_id() );
+         BOOST_CHECK( manifest.chain_id == db.get_chain_id() );
+         BOOST_CHECK_THROW( db.create_snapshot( snapshot_dir ), fc::exception );
+         db.close();
+      }
+      {
+         database db;
+         db.open_from_snapshot( import_dir.path(), snapshot_dir );
+         BOOST_CHECK_EQUAL( db.head_block_num(), manifest.block_num );
+         BOOST_CHECK( db.head_block_id() == manifest.block_id );
+         BOOST_CHECK( db.fetch_block_by_number( manifest.block_num )->id() == manifest.block_id );
+         BOOST_CHECK( !db.fetch_block_by_number( manifest.block_num - 1 ).valid() );
+         for( uint32_t i = 0; i < 30; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         BOOST_CHECK_EQUAL( db.head_block_num(), manifest.block_num + 30 );
+         db.close();
+      }
+      {
+         // the state saved on close is used from then on, with no blocks before the snapshot needed
+         database db;
+         db.open( import_dir.path(), []{return genesis_state_type();} );
+         BOOST_CHECK( db.head_block_num() > manifest.block_num );
+         head_id = db.head_block_id();
+         db.close();
+      }
+      {
+         // a replay starts from the copy of the snapshot kept, and keeps the blocks after it
+         database db;
+         db.reindex( import_dir.path(), genesis_state_type() );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         BOOST_CHECK( db.fetch_block_by_number( manifest.block_num )->id() == manifest.block_id );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( undo_block )
 {
    try {
@@ -225,6 +514,45 @@ BOOST_AUTO_TEST_CASE( undo_block )
    }
 }
 
+BOOST_AUTO_TEST_CASE( state_checkpoint_recovery )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      block_id_type head_id;
+      {
+         database db;
+         db.set_state_checkpoint_interval( 5, 1 );
+         db.open(data_dir.path(), make_genesis);
+         for( uint32_t i = 0; i < 18; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         // deltas at blocks 5, 10 and 15, each merged into the previous ones in the background
+         BOOST_CHECK_EQUAL( db.checkpoint_count(), 3u );
+         db.wait_for_checkpoint_merge();
+         const fc::path checkpoints = data_dir.path() / "object_database" / "checkpoints";
+         BOOST_CHECK( fc::exists( checkpoints / "merged" ) );
+         BOOST_CHECK( !fc::exists( checkpoints / "1" ) );
+         BOOST_CHECK( !fc::exists( checkpoints / "3" ) );
+         head_id = db.head_block_id();
+         // simulate a crash by not calling close()
+      }
+      {
+         database db;
+         db.set_state_checkpoint_interval( 5, 1 );
+         db.open(data_dir.path(), make_genesis);
+         BOOST_CHECK_EQUAL( db.head_block_num(), 18u );
+         BOOST_CHECK( db.head_block_id() == head_id );
+         for( uint32_t i = 0; i < 2; ++i )
+            db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing );
+         BOOST_CHECK_EQUAL( db.head_block_num(), 20u );
+         db.close();
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( fork_blocks )
 {
    try {
@@ -1254,4 +1582,385 @@ BOOST_FIXTURE_TEST_CASE( miss_many_blocks, database_fixture )
    }
 }
 
+BOOST_AUTO_TEST_CASE( shared_block_test )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      for( uint32_t i = 0; i < 5; ++i )
+      {
+         auto b = std::make_shared<const shared_block>(
+                     db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) );
+         BOOST_CHECK( b->id() == b->block().id() );
+         BOOST_CHECK( *b->packed() == fc::raw::pack( b->block() ) );
+         db2.push_block( b );
+
+         // the database keeps the pushed block itself and serves its packed bytes as they are
+         BOOST_CHECK( db2.fetch_shared_block_by_id( b->id() ) == b->block_ptr() );
+         BOOST_CHECK( db2.fetch_shared_block_by_number( b->block_num() ) == b->block_ptr() );
+         BOOST_CHECK( db2.fetch_packed_block_by_id( b->id() ) == b->packed() );
+      }
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( out_of_order_blocks )
+{
+   try {
+      fc::temp_directory data_dir1( graphene::utilities::temp_directory_path() );
+      fc::temp_directory data_dir2( graphene::utilities::temp_directory_path() );
+      database db1;
+      db1.open(data_dir1.path(), make_genesis);
+      database db2;
+      db2.open(data_dir2.path(), make_genesis);
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+
+      vector<shared_block_ptr> blocks;
+      for( uint32_t i = 0; i < 10; ++i )
+         blocks.push_back( std::make_shared<const shared_block>(
+            db1.generate_block(db1.get_slot_time(1), db1.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing) ) );
+
+      // blocks that arrive before their previous block are kept and applied once it arrives
+      db2.push_block( blocks[0] );
+      for( uint32_t i = 9; i > 1; --i )
+      {
+         BOOST_CHECK_THROW( db2.push_block( blocks[i] ), unlinkable_block_exception );
+         BOOST_CHECK( db2.is_known_block( blocks[i]->id() ) );
+      }
+      BOOST_CHECK_EQUAL( db2.head_block_num(), 1 );
+      db2.push_block( blocks[1] );
+      BOOST_CHECK( db2.head_block_id() == db1.head_block_id() );
+
+      // the blocks kept are limited, those furthest ahead are dropped first
+      fork_database fdb;
+      fdb.start_block( blocks[0] );
+      for( uint32_t i = 2; i < 10; ++i )
+         BOOST_CHECK_THROW( fdb.push_block( blocks[i] ), unlinkable_block_exception );
+      BOOST_CHECK_EQUAL( fdb.unlinked_count(), 8 );
+      // the blocks kept are not served as part of the chain
+      BOOST_CHECK( !fdb.is_known_block( blocks[2]->id() ) );
+      BOOST_CHECK( !fdb.fetch_block( blocks[2]->id() ) );
+      BOOST_CHECK( fdb.fetch_unlinked_block( blocks[2]->id() ) );
+      fdb.set_max_unlinked( 6, blocks[2]->packed()->size() * 100 );
+      BOOST_CHECK_EQUAL( fdb.unlinked_count(), 6 );
+      BOOST_CHECK( !fdb.fetch_unlinked_block( blocks[8]->id() ) );
+      fdb.set_max_unlinked( 6, blocks[2]->packed()->size() + blocks[3]->packed()->size() + blocks[4]->packed()->size() );
+      BOOST_CHECK_EQUAL( fdb.unlinked_count(), 3 );
+      BOOST_CHECK( fdb.push_block( blocks[1] )->id == blocks[4]->id() );
+      BOOST_CHECK_EQUAL( fdb.unlinked_count(), 0 );
+
+      // removing a block removes the blocks built on it, linked or not
+      BOOST_CHECK_THROW( fdb.push_block( blocks[6] ), unlinkable_block_exception );
+      BOOST_CHECK_EQUAL( fdb.unlinked_count(), 1 );
+      fdb.remove( blocks[5]->id() );
+      BOOST_CHECK_EQUAL( fdb.unlinked_count(), 0 );
+      fdb.remove( blocks[3]->id() );
+      BOOST_CHECK( fdb.is_known_block( blocks[2]->id() ) );
+      BOOST_CHECK( !fdb.is_known_block( blocks[3]->id() ) );
+      BOOST_CHECK( !fdb.is_known_block( blocks[4]->id() ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( transaction_id_index_test )
+{
+   try {
+      fc::temp_directory data_dir( graphene::utilities::temp_directory_path() );
+      auto init_account_priv_key = fc::ecc::private_key::regenerate(fc::sha256::hash(string("null_key")) );
+      transaction_id_type trx_id;
+      uint32_t trx_block_num = 0;
+      auto check_found = [&]( const database& db )
+      {
+         optional<transaction_location> loc = db.find_transaction( trx_id );
+         BOOST_REQUIRE( loc.valid() );
+         BOOST_CHECK_EQUAL( loc->block_num, trx_block_num );
+         BOOST_CHECK_EQUAL( loc->trx_in_block, 0 );
+         BOOST_CHECK( !db.find_transaction( transaction_id_type() ).valid() );
+      };
+      {
+         database db;
+         db.enable_transaction_id_index( true );
+         db.open(data_dir.path(), make_genesis);
+         for( uint32_t i = 0; i < 10; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+
+         transfer_operation t;
+         t.to = account_id_type(1);
+         t.amount = asset( 10000000 );
+         signed_transaction trx;
+         set_expiration( db, trx );
+         trx.operations.push_back(t);
+         PUSH_TX( db, trx, ~0 );
+         trx_id = trx.id();
+         BOOST_CHECK( !db.find_transaction( trx_id ).valid() );
+         trx_block_num = db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, ~0).block_num();
+         for( uint32_t i = 0; i < 50; ++i )
+            db.generate_block(db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key, database::skip_nothing);
+         // the block stays in the block log on close
+         BOOST_REQUIRE( db.get_dynamic_global_properties().last_irreversible_block_num >= trx_block_num );
+         check_found( db );
+         db.close();
+      }
+      {
+         database db;
+         db.enable_transaction_id_index( true );
+         db.open(data_dir.path(), make_genesis);
+         check_found( db );
+         db.close();
+      }
+      {
+         // an index that was lost is rebuilt from the block log
+         fc::remove_all( data_dir.path() / "database" / "transaction_id_index" );
+         database db;
+         db.enable_transaction_id_index( true );
+         db.open(data_dir.path(), make_genesis);
+         check_found( db );
+         db.close();
+      }
+      {
+         database db;
+         db.enable_transaction_id_index( true );
+         db.reindex( data_dir.path(), make_genesis() );
+         check_found( db );
+      }
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( parallel_signature_recovery, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      generate_block();
+      db.set_signature_recovery_threads( 3 );
+
+      for( int i = 1; i <= 8; ++i )
+         PUSH_TX( db, make_transfer( alice_id, bob_id, asset( i ), alice_private_key ) );
+
+      // both are dropped when the block is generated with signatures checked
+      PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 100 ), bob_private_key ), ~0 );
+      signed_transaction duplicate_sig = make_transfer( alice_id, bob_id, asset( 200 ), alice_private_key );
+      duplicate_sig.signatures.push_back( duplicate_sig.signatures.back() );
+      PUSH_TX( db, duplicate_sig, ~0 );
+
+      signed_block b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                          database::skip_nothing );
+      BOOST_CHECK_EQUAL( b.transactions.size(), 8u );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 36 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( signature_cache_test, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      generate_block();
+      db.set_signature_cache_size( 1000 );
+
+      for( int i = 1; i <= 3; ++i )
+         PUSH_TX( db, make_transfer( alice_id, bob_id, asset( i ), alice_private_key ) );
+      signature_cache_statistics stats = db.get_signature_cache_statistics();
+      BOOST_CHECK_EQUAL( stats.key_count, 3u );
+      BOOST_CHECK_EQUAL( stats.misses, 3u );
+      BOOST_CHECK_EQUAL( stats.hits, 0u );
+
+      // the pending transactions are checked again without recovering their keys
+      signed_block b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                          database::skip_nothing );
+      BOOST_CHECK_EQUAL( b.transactions.size(), 3u );
+      stats = db.get_signature_cache_statistics();
+      BOOST_CHECK_EQUAL( stats.misses, 3u );
+      BOOST_CHECK_GE( stats.hits, 3u );
+
+      // a signature found in the cache still counts as a duplicate
+      signed_transaction duplicate_sig = make_transfer( alice_id, bob_id, asset( 4 ), alice_private_key );
+      duplicate_sig.signatures.push_back( duplicate_sig.signatures.back() );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, duplicate_sig ), tx_duplicate_sig );
+
+      generate_blocks( db.head_block_time() + fc::hours( 1 ) );
+      BOOST_CHECK_EQUAL( db.get_signature_cache_statistics().key_count, 0u );
+
+      // a transaction claiming to expire too far ahead is rejected after its key is recovered, which is then kept
+      // no longer than the key of a valid transaction could be
+      signed_transaction far_expiration = make_transfer( alice_id, bob_id, asset( 5 ), alice_private_key );
+      far_expiration.set_expiration( db.head_block_time() + fc::days( 3650 ) );
+      far_expiration.signatures.clear();
+      sign( far_expiration, alice_private_key );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, far_expiration ), fc::exception );
+      BOOST_CHECK_EQUAL( db.get_signature_cache_statistics().key_count, 1u );
+      generate_blocks( db.head_block_time() + fc::seconds( db.get_global_properties().parameters.maximum_time_until_expiration )
+                       + fc::hours( 1 ) );
+      BOOST_CHECK_EQUAL( db.get_signature_cache_statistics().key_count, 0u );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( block_cache_test, database_fixture )
+{
+   try
+   {
+      db.set_block_cache_size( 1024 * 1024, true );
+      generate_blocks( 50 );
+
+      // block 1 is irreversible by now, so it is read from the block log rather than the fork database
+      const block_cache_statistics before = db.get_block_cache_statistics();
+      auto first = db.fetch_shared_block_by_number( 1 );
+      auto second = db.fetch_shared_block_by_number( 1 );
+      BOOST_REQUIRE( first );
+      BOOST_CHECK( first == second );
+      BOOST_CHECK( db.fetch_shared_block_by_id( first->id() ) == first );
+
+      auto packed = db.fetch_packed_block_by_id( first->id() );
+      BOOST_REQUIRE( packed );
+      BOOST_CHECK( *packed == fc::raw::pack( *first ) );
+
+      const block_cache_statistics after = db.get_block_cache_statistics();
+      BOOST_CHECK_EQUAL( after.misses - before.misses, 1 );
+      BOOST_CHECK_EQUAL( after.hits - before.hits, 3 );
+      BOOST_CHECK( after.block_count >= 1 );
+      BOOST_CHECK( after.bytes <= after.capacity );
+
+      // blocks larger than the whole cache are read but not kept
+      db.set_block_cache_size( 1, false );
+      BOOST_CHECK_EQUAL( db.get_block_cache_statistics().block_count, 0 );
+      auto uncached = db.fetch_shared_block_by_number( 1 );
+      BOOST_REQUIRE( uncached );
+      BOOST_CHECK( uncached != first );
+      BOOST_CHECK( uncached->id() == first->id() );
+      BOOST_CHECK_EQUAL( db.get_block_cache_statistics().block_count, 0 );
+
+      db.set_block_cache_size( 0, false );
+      BOOST_CHECK( db.fetch_block_by_number( 1 )->id() == first->id() );
+   }
+   catch (fc::exception& e)
+   {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_authority_revalidation, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      transfer( account_id_type(), bob_id, asset( 1000000 ) );
+      generate_block();
+
+      // a block that moves alice's active authority to a new key
+      const fc::ecc::private_key new_key = generate_private_key( "alice_new" );
+      {
+         account_update_operation op;
+         op.account = alice_id;
+         op.active = authority( 1, public_key_type( new_key.get_public_key() ), 1 );
+         signed_transaction tx;
+         tx.operations.push_back( op );
+         set_expiration( db, tx );
+         sign( tx, alice_private_key );
+         PUSH_TX( db, tx, database::skip_nothing );
+      }
+      signed_block b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                          database::skip_nothing );
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), 1u );
+      db.pop_block();
+
+      // both are valid before the block, only bob's one is still valid after it
+      PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 10 ), alice_private_key ), database::skip_nothing );
+      PUSH_TX( db, make_transfer( bob_id, alice_id, asset( 20 ), bob_private_key ), database::skip_nothing );
+      PUSH_BLOCK( db, b, database::skip_nothing );
+
+      signed_block next = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                             database::skip_nothing );
+      BOOST_CHECK_EQUAL( next.transactions.size(), 1u );
+      BOOST_CHECK_EQUAL( db.get_balance( alice_id, asset_id_type() ).amount.value, 1000020 );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 999980 );
+
+      // with the new key nothing needs to be checked against a changed account
+      PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 30 ), new_key ), database::skip_nothing );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_balance( alice_id, asset_id_type() ).amount.value, 999990 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
+BOOST_FIXTURE_TEST_CASE( pending_transaction_pool, database_fixture )
+{
+   try
+   {
+      ACTORS( (alice)(bob) );
+      transfer( account_id_type(), alice_id, asset( 1000000 ) );
+      transfer( account_id_type(), bob_id, asset( 1000 ) );
+      generate_block();
+
+      // no account pays for more than two pending transactions
+      db.set_pending_transaction_limits( 0, 2 );
+      PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 1 ), alice_private_key ) );
+      PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 2 ), alice_private_key ) );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 3 ), alice_private_key ) ),
+                              pending_account_limit_exceeded );
+      PUSH_TX( db, make_transfer( bob_id, alice_id, asset( 5 ), bob_private_key ) );
+      BOOST_CHECK_EQUAL( db.get_pending_transaction_statistics().transaction_count, 3u );
+      generate_block();
+      BOOST_CHECK_EQUAL( db.get_pending_transaction_statistics().transaction_count, 0u );
+
+      // room for two transactions, a third one only gets in by paying more than the cheapest
+      const uint32_t size = fc::raw::pack_size( make_transfer( alice_id, bob_id, asset( 10 ), alice_private_key,
+                                                               asset( 100 ) ) );
+      db.set_pending_transaction_limits( size * 2 + size / 2, 0 );
+      const signed_transaction cheapest = make_transfer( alice_id, bob_id, asset( 10 ), alice_private_key, asset( 100 ) );
+      PUSH_TX( db, cheapest );
+      PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 11 ), alice_private_key, asset( 200 ) ) );
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, make_transfer( alice_id, bob_id, asset( 12 ), alice_private_key, asset( 50 ) ) ),
+                              pending_pool_full );
+      const signed_transaction best = make_transfer( alice_id, bob_id, asset( 13 ), alice_private_key, asset( 300 ) );
+      PUSH_TX( db, best );
+      // the evicted transfer leaves the pending state along with the pool
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 1000 - 5 + 1 + 2 + 11 + 13 );
+
+      // a duplicate is turned away as such, without evicting anything or counting as a rejection
+      GRAPHENE_REQUIRE_THROW( PUSH_TX( db, best ), fc::assert_exception );
+
+      transaction_pool_statistics stats = db.get_pending_transaction_statistics();
+      BOOST_CHECK_EQUAL( stats.transaction_count, 2u );
+      BOOST_CHECK_EQUAL( stats.byte_count, size * 2 );
+      BOOST_CHECK_EQUAL( stats.evictions, 1u );
+      BOOST_CHECK_EQUAL( stats.rejections, 2u );
+
+      // an evicted transaction is not known any more, it gets back in once there is room for it
+      db.set_pending_transaction_limits( size * 3 + size / 2, 0 );
+      PUSH_TX( db, cheapest );
+      BOOST_CHECK_EQUAL( db.get_pending_transaction_statistics().transaction_count, 3u );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 1000 - 5 + 1 + 2 + 10 + 11 + 13 );
+
+      // the best paying transaction goes first
+      signed_block b = db.generate_block( db.get_slot_time(1), db.get_scheduled_witness(1), init_account_priv_key,
+                                          database::skip_nothing );
+      BOOST_REQUIRE_EQUAL( b.transactions.size(), 3u );
+      BOOST_CHECK_EQUAL( b.transactions[0].operations[0].get<transfer_operation>().fee.amount.value, 300 );
+      BOOST_CHECK_EQUAL( b.transactions[1].operations[0].get<transfer_operation>().fee.amount.value, 200 );
+      BOOST_CHECK_EQUAL( b.transactions[2].operations[0].get<transfer_operation>().fee.amount.value, 100 );
+      BOOST_CHECK_EQUAL( db.get_balance( bob_id, asset_id_type() ).amount.value, 1000 - 5 + 1 + 2 + 10 + 11 + 13 );
+   }
+   FC_LOG_AND_RETHROW()
+}
+
 BOOST_AUTO_TEST_SUITE_END()
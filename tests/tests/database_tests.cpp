@@ -24,6 +24,7 @@
 #include <graphene/chain/database.hpp>
 
 #include <graphene/chain/account_object.hpp>
+#include <graphene/chain/asset_object.hpp>
 
 #include <fc/crypto/digest.hpp>
 
@@ -56,3 +57,269 @@ BOOST_AUTO_TEST_CASE( undo_test )
       throw;
    }
 }
+
+BOOST_AUTO_TEST_CASE( read_view_test )
+{
+   try {
+      database db;
+      db.enable_read_views( true );
+      const auto& bal1 = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+         obj.owner = account_id_type(1);
+         obj.balance = 10;
+      });
+      const auto& bal2 = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+         obj.owner = account_id_type(2);
+         obj.balance = 20;
+      });
+      auto id1 = bal1.id;
+      auto id2 = bal2.id;
+
+      db.publish_read_view( 1 );
+      auto view1 = db.get_read_view();
+      BOOST_REQUIRE( view1 );
+      BOOST_CHECK_EQUAL( view1->version(), 1u );
+      BOOST_CHECK_EQUAL( view1->find<account_balance_object>( id1 )->balance.value, 10 );
+
+      db.modify( bal1, []( account_balance_object& obj ){ obj.balance = 11; } );
+      db.remove( bal2 );
+      // the published view is not affected by changes to the database
+      BOOST_CHECK_EQUAL( view1->find<account_balance_object>( id1 )->balance.value, 10 );
+      BOOST_CHECK( view1->find( id2 ) != nullptr );
+
+      db.publish_read_view( 2 );
+      auto view2 = db.get_read_view();
+      BOOST_CHECK_EQUAL( view2->version(), 2u );
+      BOOST_CHECK_EQUAL( view2->find<account_balance_object>( id1 )->balance.value, 11 );
+      BOOST_CHECK( view2->find( id2 ) == nullptr );
+      BOOST_CHECK_EQUAL( view1->find<account_balance_object>( id1 )->balance.value, 10 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( simple_index_test )
+{
+   try {
+      database db;
+      const uint32_t count = 5000;
+      const auto& first = db.create<account_statistics_object>( [&]( account_statistics_object& obj ){
+         obj.owner = account_id_type(0);
+      });
+      const account_statistics_object* first_ptr = &first;
+      vector<account_statistics_id_type> ids;
+      for( uint32_t i = 1; i < count; ++i )
+         ids.push_back( db.create<account_statistics_object>( [&]( account_statistics_object& obj ){
+            obj.owner = account_id_type(i);
+         }).id );
+      // growing the index does not move existing objects
+      BOOST_CHECK( db.find_object( first_ptr->id ) == first_ptr );
+      BOOST_CHECK( first_ptr->owner == account_id_type(0) );
+
+      for( uint32_t i = 0; i < ids.size(); i += 2 )
+         db.remove( ids[i](db) );
+      BOOST_CHECK( db.find( ids[0] ) == nullptr );
+      BOOST_CHECK( db.find( ids[1] ) != nullptr );
+
+      const auto& idx = db.get_index_type<simple_index<account_statistics_object>>();
+      uint32_t seen = 0;
+      for( const account_statistics_object& s : idx )
+      {
+         BOOST_CHECK( s.owner.instance.value % 2 == 0 );
+         ++seen;
+      }
+      BOOST_CHECK_EQUAL( seen, count / 2 );
+      // the highest instance was removed, so the index shrinks past it
+      BOOST_CHECK_EQUAL( idx.size(), count - 1 );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( index_statistics_test )
+{
+   try {
+      database db;
+      auto balance_stats = [&]() -> index_statistics {
+         for( const auto& s : db.get_index_statistics() )
+            if( s.space_id == account_balance_object::space_id && s.type_id == account_balance_object::type_id )
+               return s;
+         BOOST_FAIL( "no statistics for the account balance index" );
+         return index_statistics();
+      };
+
+      vector<const account_balance_object*> balances;
+      for( int i = 0; i < 3; ++i )
+         balances.push_back( &db.create<account_balance_object>( [&]( account_balance_object& obj ){
+            obj.owner = account_id_type(i);
+         }) );
+      auto stats = balance_stats();
+      BOOST_CHECK_EQUAL( stats.object_count, 3u );
+      BOOST_CHECK_EQUAL( stats.creates, 3u );
+      BOOST_CHECK( stats.approximate_bytes >= 3 * sizeof(account_balance_object) );
+
+      const size_t packed_size = fc::raw::pack_size( *balances[0] );
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.modify( *balances[0], []( account_balance_object& obj ){ obj.balance = 1; } );
+         db.modify( *balances[0], []( account_balance_object& obj ){ obj.balance = 2; } );
+         db.remove( *balances[2] );
+         stats = balance_stats();
+         BOOST_CHECK_EQUAL( stats.object_count, 2u );
+         BOOST_CHECK_EQUAL( stats.modifies, 2u );
+         BOOST_CHECK_EQUAL( stats.removes, 1u );
+         // only the first modification of an object in a session saves its pre-image
+         BOOST_CHECK_EQUAL( stats.undo_bytes, packed_size );
+         ses.undo();
+      }
+      BOOST_CHECK_EQUAL( balance_stats().object_count, 3u );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( state_digest_test )
+{
+   try {
+      database db;
+      db.enable_state_digest( true );
+      // recomputes every index digest from scratch
+      auto full_digest = [&]() -> fc::sha256 {
+         db.enable_state_digest( true );
+         return db.get_state_digest();
+      };
+
+      const auto& bal1 = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+         obj.owner = account_id_type(1);
+         obj.balance = 10;
+      });
+      const auto& bal2 = db.create<account_balance_object>( [&]( account_balance_object& obj ){
+         obj.owner = account_id_type(2);
+         obj.balance = 20;
+      });
+      auto before = db.get_state_digest();
+      BOOST_CHECK( before == full_digest() );
+
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.modify( bal1, []( account_balance_object& obj ){ obj.balance = 11; } );
+         db.remove( bal2 );
+         db.create<account_balance_object>( [&]( account_balance_object& obj ){
+            obj.owner = account_id_type(3);
+         });
+         auto during = db.get_state_digest();
+         BOOST_CHECK( during != before );
+         BOOST_CHECK( during == full_digest() );
+         ses.undo();
+      }
+      BOOST_CHECK( db.get_state_digest() == before );
+      BOOST_CHECK( db.get_state_digest() == full_digest() );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_AUTO_TEST_CASE( flat_index_digest_test )
+{
+   try {
+      database db;
+      db.enable_state_digest( true );
+      auto full_digest = [&]() -> fc::sha256 {
+         db.enable_state_digest( true );
+         return db.get_state_digest();
+      };
+
+      // asset_bitasset_data_index is a flat_index
+      const auto& data1 = db.create<asset_bitasset_data_object>( []( asset_bitasset_data_object& obj ){
+         obj.force_settled_volume = 1;
+      });
+      const auto& data2 = db.create<asset_bitasset_data_object>( []( asset_bitasset_data_object& obj ){
+         obj.force_settled_volume = 2;
+      });
+      const auto data2_id = data2.id;
+      auto before = db.get_state_digest();
+      BOOST_CHECK( before == full_digest() );
+
+      {
+         auto ses = db._undo_db.start_undo_session( true );
+         db.remove( data1 );
+         BOOST_CHECK( db.get_state_digest() != before );
+         BOOST_CHECK( db.get_state_digest() == full_digest() );
+         ses.undo();
+      }
+      BOOST_CHECK( db.get_state_digest() == before );
+      BOOST_CHECK( db.get_state_digest() == full_digest() );
+
+      db.remove( data2_id(db) );
+      BOOST_CHECK( db.find( data2_id ) == nullptr );
+      BOOST_CHECK( db.get_state_digest() == full_digest() );
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
+
+BOOST_FIXTURE_TEST_CASE( bulk_load_secondary_index_test, database_fixture )
+{
+   try {
+      ACTORS((alice)(bob));
+      const auto& aidx = dynamic_cast<const primary_index<account_index>&>( db.get_index_type<account_index>() );
+      const auto& members = aidx.get_secondary_index<account_member_index>();
+
+      // a rebuild produces the same index as maintaining it object by object
+      const auto account_memberships = members.account_to_account_memberships;
+      const auto key_memberships     = members.account_to_key_memberships;
+      const auto address_memberships = members.account_to_address_memberships;
+      db.begin_bulk_load();
+      db.end_bulk_load();
+      BOOST_CHECK( members.account_to_account_memberships == account_memberships );
+      BOOST_CHECK( members.account_to_key_memberships == key_memberships );
+      BOOST_CHECK( members.account_to_address_memberships == address_memberships );
+
+      // accounts created during a bulk load are indexed once it ends
+      db.begin_bulk_load();
+      PREP_ACTOR(carol);
+      const auto& carol = create_account( "carol", carol_public_key );
+      BOOST_CHECK( members.account_to_key_memberships.find( carol_public_key ) == members.account_to_key_memberships.end() );
+      db.end_bulk_load();
+      auto itr = members.account_to_key_memberships.find( carol_public_key );
+      BOOST_REQUIRE( itr != members.account_to_key_memberships.end() );
+      BOOST_CHECK( itr->second.count( carol.id ) == 1 );
+      BOOST_CHECK( members.account_to_key_memberships.find( alice_public_key )->second.count( alice_id ) == 1 );
+
+      // a load that throws still ends the bulk load, with the objects it created indexed
+      PREP_ACTOR(dave);
+      account_id_type dave_id;
+      try {
+         object_database::bulk_load_guard bulk_load( db );
+         BOOST_CHECK( db.in_bulk_load() );
+         dave_id = create_account( "dave", dave_public_key ).id;
+         FC_THROW( "load failed" );
+      } catch( const fc::exception& ) {}
+      BOOST_CHECK( !db.in_bulk_load() );
+      itr = members.account_to_key_memberships.find( dave_public_key );
+      BOOST_REQUIRE( itr != members.account_to_key_memberships.end() );
+      BOOST_CHECK( itr->second.count( dave_id ) == 1 );
+
+      // a guard inside a bulk load that is already in progress leaves it to its owner
+      db.begin_bulk_load();
+      {
+         object_database::bulk_load_guard bulk_load( db );
+         bulk_load.complete();
+      }
+      BOOST_CHECK( db.in_bulk_load() );
+      db.end_bulk_load();
+   } catch ( const fc::exception& e )
+   {
+      edump( (e.to_detail_string()) );
+      throw;
+   }
+}
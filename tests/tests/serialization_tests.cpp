@@ -70,6 +70,39 @@ BOOST_AUTO_TEST_CASE( serialization_json_test )
    }
 }
 
+BOOST_AUTO_TEST_CASE( compute_digests_test )
+{
+   try {
+      make_account();
+      transfer_operation op;
+      op.from = account_id_type(1);
+      op.to = account_id_type(2);
+      op.amount = asset(100);
+      trx.operations.push_back( op );
+      trx.sign( init_account_priv_key, db.get_chain_id() );
+      trx.sign( generate_private_key( "other" ), db.get_chain_id() );
+
+      const transaction_digests without_chain = trx.compute_digests();
+      BOOST_CHECK( without_chain.id == trx.id() );
+      BOOST_CHECK( !without_chain.sig_digest.valid() );
+
+      const transaction_digests d = trx.compute_digests( &db.get_chain_id() );
+      BOOST_CHECK( d.id == trx.id() );
+      BOOST_REQUIRE( d.sig_digest.valid() );
+      BOOST_CHECK( *d.sig_digest == trx.sig_digest( db.get_chain_id() ) );
+      BOOST_CHECK_EQUAL( d.pack_size, fc::raw::pack_size( trx ) );
+
+      // the size of a processed transaction does not count its results
+      processed_transaction ptrx( trx );
+      ptrx.operation_results.push_back( void_result() );
+      BOOST_CHECK( ptrx.compute_digests().id == trx.id() );
+      BOOST_CHECK_EQUAL( ptrx.compute_digests().pack_size, fc::raw::pack_size( trx ) );
+   } catch (fc::exception& e) {
+      edump((e.to_detail_string()));
+      throw;
+   }
+}
+
 BOOST_AUTO_TEST_CASE( json_tests )
 {
    try {